@@ -0,0 +1,185 @@
+// ThreadPool throughput benchmark: work-stealing pool with inline Tasks vs
+// the previous single-queue std::function pool, at 4 / 16 / 64 workers.
+//
+// Usage: bench_threadpool [tasks=1000000] [producers=4]
+
+#include "../includes/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// The pre-work-stealing pool: one std::function queue behind one mutex.
+    class LegacyThreadPool
+    {
+    public:
+        explicit LegacyThreadPool(std::size_t num_threads)
+        {
+            for (std::size_t i = 0; i < num_threads; ++i)
+                workers_.emplace_back([this]
+                                      { loop(); });
+        }
+
+        ~LegacyThreadPool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            for (auto& w : workers_)
+                w.join();
+        }
+
+        void enqueue(std::function<void()> task)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                tasks_.emplace(std::move(task));
+            }
+            cv_.notify_one();
+        }
+
+    private:
+        std::vector<std::thread> workers_;
+        std::queue<std::function<void()>> tasks_;
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        bool stop_ = false;
+
+        void loop()
+        {
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    cv_.wait(lock, [this]
+                             { return stop_ || !tasks_.empty(); });
+                    if (stop_ && tasks_.empty()) return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop();
+                }
+                task();
+            }
+        }
+    };
+
+    /// Stand-in for a server object: tasks capture [this, fd] like run_strand's.
+    struct Target
+    {
+        std::atomic<long> done{0};
+        std::atomic<long> sink{0};
+
+        void handle(int fd)
+        {
+            // A few dozen ns of work, roughly a short command
+            unsigned h = static_cast<unsigned>(fd);
+            for (int i = 0; i < 32; ++i)
+                h = h * 2654435761u + 0x9e3779b9u;
+            if (h == 42) sink.fetch_add(1, std::memory_order_relaxed);
+            done.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    enum class Mode
+    {
+        Single,  ///< One enqueue() per task
+        Batched  ///< enqueue_batch() in chunks of 64, like one epoll pass
+    };
+
+    /**
+     * @brief Push @p tasks tasks from @p producers threads and wait for all to run.
+     * @return Tasks per second.
+     */
+    template <typename Submit>
+    double run(long tasks, int producers, Target& target, Submit submit)
+    {
+        target.done.store(0);
+        long per = tasks / producers;
+        long total = per * producers;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+            threads.emplace_back([&, p]
+                                 { submit(p, per); });
+        for (auto& t : threads)
+            t.join();
+        while (target.done.load(std::memory_order_acquire) < total)
+            std::this_thread::yield();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return static_cast<double>(total) / elapsed.count();
+    }
+
+    double runLegacy(std::size_t workers, long tasks, int producers)
+    {
+        Target target;
+        LegacyThreadPool pool(workers);
+        return run(tasks, producers, target, [&](int p, long n)
+                   {
+                       Target* t = &target;
+                       for (long i = 0; i < n; ++i)
+                       {
+                           int fd = static_cast<int>(p * n + i);
+                           pool.enqueue([t, fd] { t->handle(fd); });
+                       } });
+    }
+
+    double runStealing(std::size_t workers, long tasks, int producers, Mode mode)
+    {
+        Target target;
+        ThreadPool pool(workers);
+        return run(tasks, producers, target, [&](int p, long n)
+                   {
+                       Target* t = &target;
+                       std::vector<Task> batch;
+                       batch.reserve(64);
+                       for (long i = 0; i < n; ++i)
+                       {
+                           int fd = static_cast<int>(p * n + i);
+                           if (mode == Mode::Single)
+                           {
+                               pool.enqueue([t, fd] { t->handle(fd); });
+                               continue;
+                           }
+                           batch.emplace_back([t, fd] { t->handle(fd); });
+                           if (batch.size() == 64) pool.enqueue_batch(batch);
+                       }
+                       pool.enqueue_batch(batch); });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long tasks = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int producers = argc > 2 ? std::atoi(argv[2]) : 4;
+    if (tasks <= 0 || producers <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [tasks] [producers]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("tasks=%ld producers=%d (Mtasks/s, higher is better)\n", tasks, producers);
+    std::printf("%-8s %12s %12s %12s %9s\n", "workers", "legacy", "stealing", "batched", "speedup");
+    for (std::size_t workers : {4, 16, 64})
+    {
+        double l = runLegacy(workers, tasks, producers);
+        double s = runStealing(workers, tasks, producers, Mode::Single);
+        double b = runStealing(workers, tasks, producers, Mode::Batched);
+        std::printf("%-8zu %12.2f %12.2f %12.2f %8.2fx\n", workers,
+                    l / 1e6, s / 1e6, b / 1e6, std::max(s, b) / l);
+    }
+    return 0;
+}
\ No newline at end of file
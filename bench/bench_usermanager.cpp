@@ -0,0 +1,190 @@
+// UserManager lookup benchmark: striped fd-indexed table vs the previous
+// unordered_map + single shared_mutex layout, at N simulated connections.
+//
+// Usage: bench_usermanager [connections=100000] [ops_per_thread=2000000]
+
+#include "../includes/Database.hpp"
+#include "../includes/UserManager.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    /// The pre-striping layout: every container behind one shared_mutex.
+    class LegacyUserManager
+    {
+    public:
+        void addClient(int fd)
+        {
+            std::unique_lock lock(mtx_);
+            clients_[fd] = ClientSession(fd);
+        }
+
+        void removeClient(int fd)
+        {
+            std::unique_lock lock(mtx_);
+            auto it = clients_.find(fd);
+            if (it == clients_.end()) return;
+            nickname_map_.erase(it->second.nickname);
+            clients_.erase(it);
+        }
+
+        void logoutUser(int fd)
+        {
+            std::unique_lock lock(mtx_);
+            auto it = clients_.find(fd);
+            if (it == clients_.end()) return;
+            nickname_map_.erase(it->second.nickname);
+            it->second.status = AuthStatus::NONE;
+            it->second.nickname.clear();
+        }
+
+        bool bind(int fd, const std::string& username)
+        {
+            std::unique_lock lock(mtx_);
+            if (nickname_map_.count(username)) return false;
+            ClientSession& s = clients_[fd];
+            s.nickname = username;
+            s.status = AuthStatus::AUTHORIZED;
+            nickname_map_[username] = fd;
+            return true;
+        }
+
+        bool hasClient(int fd) const
+        {
+            std::shared_lock lock(mtx_);
+            return clients_.count(fd) > 0;
+        }
+
+        bool isLoggedIn(int fd) const
+        {
+            std::shared_lock lock(mtx_);
+            auto it = clients_.find(fd);
+            return it != clients_.end() && it->second.status == AuthStatus::AUTHORIZED;
+        }
+
+        std::string getNickname(int fd) const
+        {
+            std::shared_lock lock(mtx_);
+            auto it = clients_.find(fd);
+            return (it != clients_.end()) ? it->second.nickname : "";
+        }
+
+        int getFdByNickname(const std::string& nickname) const
+        {
+            std::shared_lock lock(mtx_);
+            auto it = nickname_map_.find(nickname);
+            return (it != nickname_map_.end()) ? it->second : -1;
+        }
+
+    private:
+        mutable std::shared_mutex mtx_;
+        std::unordered_map<int, ClientSession> clients_;
+        std::unordered_map<std::string, int> nickname_map_;
+    };
+
+    constexpr int kFirstFd = 16; ///< Keep clear of stdio / listen / epoll fds
+
+    std::string userName(int i) { return "user" + std::to_string(i); }
+
+    /**
+     * @brief Run the per-command lookup mix on @p threads threads.
+     *
+     * Each op is what one chat command costs in lookups: hasClient,
+     * isLoggedIn, getNickname and one getFdByNickname for a target.
+     * One op in 1000 is a logout + disconnect + reconnect to keep writers
+     * in play. @return Wall-clock nanoseconds for the whole run.
+     */
+    template <typename Manager>
+    double run(Manager& mgr, int connections, int threads, long ops)
+    {
+        std::vector<std::string> names;
+        names.reserve(connections);
+        for (int i = 0; i < connections; ++i)
+            names.push_back(userName(i));
+
+        auto worker = [&](int seed)
+        {
+            std::mt19937 rng(static_cast<unsigned>(seed));
+            std::uniform_int_distribution<int> pick(0, connections - 1);
+            long sink = 0;
+            for (long i = 0; i < ops; ++i)
+            {
+                int idx = pick(rng);
+                int fd = kFirstFd + idx;
+                if (i % 1000 == 999)
+                {
+                    mgr.logoutUser(fd);
+                    mgr.removeClient(fd);
+                    mgr.addClient(fd);
+                    continue;
+                }
+                sink += mgr.hasClient(fd);
+                sink += mgr.isLoggedIn(fd);
+                sink += static_cast<long>(mgr.getNickname(fd).size());
+                sink += mgr.getFdByNickname(names[pick(rng)]);
+            }
+            if (sink == 42) std::puts(""); // keep the loop observable
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t)
+            pool.emplace_back(worker, t + 1);
+        for (auto& t : pool)
+            t.join();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        return elapsed.count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? std::atoi(argv[1]) : 100000;
+    long ops = argc > 2 ? std::atol(argv[2]) : 2000000;
+    if (connections <= 0 || ops <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [connections] [ops_per_thread]\n", argv[0]);
+        return 1;
+    }
+
+    Database db;
+    if (!db.open(":memory:"))
+        return 1;
+
+    // Lookups are what is measured: register with a trivial KDF cost
+    UserManager striped(db, static_cast<std::size_t>(kFirstFd + connections), 1);
+    LegacyUserManager legacy;
+    for (int i = 0; i < connections; ++i)
+    {
+        int fd = kFirstFd + i;
+        striped.addClient(fd);
+        striped.registerUser(fd, userName(i), "password");
+        legacy.addClient(fd);
+        legacy.bind(fd, userName(i));
+    }
+
+    std::printf("connections=%d ops/thread=%ld\n", connections, ops);
+    std::printf("%-8s %14s %14s %14s %14s %9s\n", "threads",
+                "legacy ns/op", "legacy Mops/s", "striped ns/op", "striped Mops/s", "speedup");
+    for (int threads : {1, 4, 16})
+    {
+        double total = static_cast<double>(ops) * threads;
+        double l = run(legacy, connections, threads, ops);
+        double s = run(striped, connections, threads, ops);
+
+        // ns/op is per-thread latency; Mops/s is aggregate throughput
+        std::printf("%-8d %14.1f %14.2f %14.1f %14.2f %8.2fx\n", threads,
+                    l / ops, total / l * 1e3, s / ops, total / s * 1e3, l / s);
+    }
+    return 0;
+}
@@ -0,0 +1,413 @@
+// Microbenchmark suite for the server's hot components. Each benchmark runs at
+// several thread counts and reports wall-clock ns/op, heap allocations/op
+// (counted by replacing the global operator new) and throughput scaling
+// relative to the first thread count.
+//
+//   threadpool      ThreadPool::enqueue from one producer, run by N workers
+//   usermanager     getAuthorizedNickname() on random fds from N threads
+//   db_insert       Database::insertMessage() from N threads, incl. final commit
+//   db_recent       Database::getRecentMessages(50) from N threads
+//   format_history  Server::renderHistory() of a 50-message page
+//   line_framing    LineBuffer receive + nextLine() per line, one buffer per thread
+//   safe_send       safe_send() of 64-byte messages over N socketpairs
+//
+// Usage: chat_bench [--filter=SUBSTR] [--threads=1,2,4,8] [--ops=N]
+
+#include "../includes/Database.hpp"
+#include "../includes/LineBuffer.hpp"
+#include "../includes/Server.hpp"
+#include "../includes/ThreadPool.hpp"
+#include "../includes/UserManager.hpp"
+#include "../includes/Utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// ── Allocation counting ─────────────────────────────────────────────
+
+namespace
+{
+    constexpr int kAllocSlots = 256;
+
+    struct alignas(64) AllocSlot
+    {
+        std::atomic<std::uint64_t> n{0};
+    };
+
+    AllocSlot g_alloc_slots[kAllocSlots];
+    std::atomic<int> g_next_alloc_slot{0};
+    thread_local int t_alloc_slot = -1;
+
+    void countAlloc()
+    {
+        int s = t_alloc_slot;
+        if (s < 0) s = t_alloc_slot = g_next_alloc_slot.fetch_add(1) % kAllocSlots;
+        g_alloc_slots[s].n.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t allocations()
+    {
+        std::uint64_t sum = 0;
+        for (const auto& slot : g_alloc_slots)
+            sum += slot.n.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    void* countedAlloc(std::size_t n)
+    {
+        countAlloc();
+        if (void* p = std::malloc(n ? n : 1)) return p;
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(std::size_t n) { return countedAlloc(n); }
+void* operator new[](std::size_t n) { return countedAlloc(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// ── Harness ─────────────────────────────────────────────────────────
+
+namespace
+{
+    struct Sample
+    {
+        double ns_per_op;
+        double allocs_per_op;
+        double mops; ///< Million operations per second
+    };
+
+    double nowSec()
+    {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// Time @p fn, which performs @p total_ops operations.
+    template <typename Fn>
+    Sample measure(long total_ops, Fn&& fn)
+    {
+        std::uint64_t a0 = allocations();
+        double t0 = nowSec();
+        fn();
+        double secs = nowSec() - t0;
+        std::uint64_t a1 = allocations();
+        auto ops = static_cast<double>(total_ops);
+        return {secs * 1e9 / ops, static_cast<double>(a1 - a0) / ops, ops / secs / 1e6};
+    }
+
+    /// Run body(thread_index, ops) on @p threads threads released together; time until all finish.
+    template <typename Body>
+    Sample runThreads(int threads, long ops, Body&& body)
+    {
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t)
+            pool.emplace_back([&, t]
+                              {
+                                  ready.fetch_add(1);
+                                  while (!go.load(std::memory_order_acquire))
+                                      std::this_thread::yield();
+                                  body(t, ops); });
+        while (ready.load() < threads)
+            std::this_thread::yield();
+
+        return measure(ops * threads, [&]
+                       {
+                           go.store(true, std::memory_order_release);
+                           for (auto& th : pool) th.join(); });
+    }
+
+    struct TempDb
+    {
+        std::string path;
+
+        TempDb()
+        {
+            char tmpl[] = "/tmp/chat_bench_XXXXXX";
+            int fd = mkstemp(tmpl);
+            if (fd >= 0) ::close(fd);
+            path = tmpl;
+        }
+
+        ~TempDb()
+        {
+            for (const char* suffix : {"", "-wal", "-shm"})
+                ::unlink((path + suffix).c_str());
+        }
+    };
+
+    // ── Benchmarks ──────────────────────────────────────────────────
+
+    Sample benchThreadPool(int threads, long ops)
+    {
+        ThreadPool pool(static_cast<std::size_t>(threads));
+        std::atomic<long> done{0};
+        long total = ops * threads; // same work per worker as the other benchmarks
+        Sample s = measure(total, [&]
+                           {
+                               for (long i = 0; i < total; ++i)
+                                   pool.enqueue([&done]
+                                                { done.fetch_add(1, std::memory_order_relaxed); });
+                               while (done.load(std::memory_order_relaxed) < total)
+                                   std::this_thread::yield(); });
+        return s;
+    }
+
+    Sample benchUserManager(int threads, long ops)
+    {
+        constexpr int kConnections = 4096;
+        constexpr int kFirstFd = 16;
+
+        Database db;
+        db.open(":memory:");
+        UserManager mgr(db, 0, 1); // KDF cost 1: setup would otherwise dominate
+        for (int i = 0; i < kConnections; ++i)
+        {
+            int fd = kFirstFd + i;
+            mgr.addClient(fd);
+            mgr.registerUser(fd, "user" + std::to_string(i), "password");
+        }
+
+        std::atomic<long> found{0};
+        Sample s = runThreads(threads, ops, [&](int t, long n)
+                              {
+                                  std::mt19937 rng(static_cast<unsigned>(t) + 1);
+                                  std::uniform_int_distribution<int> pick(kFirstFd, kFirstFd + kConnections - 1);
+                                  std::string nick;
+                                  nick.reserve(32);
+                                  long hits = 0;
+                                  for (long i = 0; i < n; ++i)
+                                      hits += mgr.getAuthorizedNickname(pick(rng), nick);
+                                  found.fetch_add(hits); });
+        db.close();
+        return s;
+    }
+
+    Sample benchDbInsert(int threads, long ops)
+    {
+        TempDb tmp;
+        Database db;
+        db.open(tmp.path);
+        const std::string content(64, 'x');
+        const std::string sender = "alice";
+        Sample s = measure(ops * threads, [&]
+                           {
+                               std::vector<std::thread> pool;
+                               for (int t = 0; t < threads; ++t)
+                                   pool.emplace_back([&]
+                                                     {
+                                                         for (long i = 0; i < ops; ++i)
+                                                             db.insertMessage(sender, "", content, "broadcast"); });
+                               for (auto& th : pool) th.join();
+                               db.flush(); });
+        db.close();
+        return s;
+    }
+
+    Sample benchDbRecent(int threads, long ops)
+    {
+        TempDb tmp;
+        Database db;
+        db.open(tmp.path);
+        const std::string content(64, 'x');
+        for (int i = 0; i < 2000; ++i)
+            db.insertMessage("alice", "", content, "broadcast");
+        db.flush();
+
+        std::atomic<std::size_t> rows{0};
+        Sample s = runThreads(threads, ops, [&](int, long n)
+                              {
+                                  std::size_t got = 0;
+                                  for (long i = 0; i < n; ++i)
+                                      got += db.getRecentMessages(50).size();
+                                  rows.fetch_add(got); });
+        db.close();
+        return s;
+    }
+
+    Sample benchFormatHistory(int threads, long ops)
+    {
+        std::vector<ChatMessage> page;
+        for (int i = 0; i < 50; ++i)
+        {
+            ChatMessage m;
+            m.id = 1000 - i;
+            m.sender = "alice";
+            m.receiver = i % 3 == 0 ? "bob" : i % 3 == 1 ? "" : "devs";
+            m.type = i % 3 == 0 ? "private" : i % 3 == 1 ? "broadcast" : "group";
+            m.content = m.type == "broadcast" ? "[alice]: hello everyone, how is it going?" : "hello there, how is it going?";
+            page.push_back(m);
+        }
+
+        std::atomic<std::size_t> bytes{0};
+        return runThreads(threads, ops, [&](int, long n)
+                          {
+                              std::size_t total = 0;
+                              for (long i = 0; i < n; ++i)
+                                  total += Server::renderHistory(page, 50).size();
+                              bytes.fetch_add(total); });
+    }
+
+    Sample benchLineFraming(int threads, long ops)
+    {
+        // One recv()'s worth of pipelined input: 64 lines, the last one split
+        std::string chunk;
+        for (int i = 0; i < 64; ++i)
+            chunk += "/to bob hello there, this is line " + std::to_string(i) + "\r\n";
+        const std::size_t split = chunk.size() - 7;
+
+        std::atomic<long> lines{0};
+        return runThreads(threads, ops, [&](int, long n)
+                          {
+                              LineBuffer buf(64 * 1024);
+                              long seen = 0;
+                              std::size_t offset = 0;
+                              while (seen < n)
+                              {
+                                  // Feed the chunk in two reads to exercise partial lines
+                                  std::size_t len = offset == 0 ? split : chunk.size() - split;
+                                  std::size_t avail = 0;
+                                  char* space = buf.writable(len, avail);
+                                  std::memcpy(space, chunk.data() + offset, len);
+                                  buf.commit(len);
+                                  offset = offset == 0 ? split : 0;
+
+                                  std::string_view line;
+                                  while (buf.nextLine(line))
+                                      ++seen;
+                              }
+                              lines.fetch_add(seen); });
+    }
+
+    Sample benchSafeSend(int threads, long ops)
+    {
+        constexpr std::size_t kMsg = 64;
+        std::vector<int> writers, readers;
+        std::vector<std::thread> drains;
+        for (int t = 0; t < threads; ++t)
+        {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+            {
+                perror("socketpair");
+                std::exit(1);
+            }
+            writers.push_back(sv[0]);
+            readers.push_back(sv[1]);
+            drains.emplace_back([fd = sv[1], want = kMsg * static_cast<std::size_t>(ops)]
+                                {
+                                    char buf[65536];
+                                    std::size_t got = 0;
+                                    while (got < want)
+                                    {
+                                        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                                        if (n <= 0) break;
+                                        got += static_cast<std::size_t>(n);
+                                    } });
+        }
+
+        const std::string msg(kMsg - 2, 'm');
+        const std::string line = msg + "\r\n";
+        Sample s = runThreads(threads, ops, [&](int t, long n)
+                              {
+                                  for (long i = 0; i < n; ++i)
+                                      safe_send(writers[static_cast<std::size_t>(t)], line.data(), line.size()); });
+
+        for (auto& th : drains) th.join();
+        for (int fd : writers) ::close(fd);
+        for (int fd : readers) ::close(fd);
+        return s;
+    }
+
+    struct Benchmark
+    {
+        const char* name;
+        Sample (*fn)(int threads, long ops);
+        long default_ops; ///< Per thread
+    };
+
+    const Benchmark kBenchmarks[] = {
+        {"threadpool", benchThreadPool, 200000},
+        {"usermanager", benchUserManager, 2000000},
+        {"db_insert", benchDbInsert, 50000},
+        {"db_recent", benchDbRecent, 20000},
+        {"format_history", benchFormatHistory, 20000},
+        {"line_framing", benchLineFraming, 2000000},
+        {"safe_send", benchSafeSend, 200000},
+    };
+
+    bool parseThreads(const std::string& spec, std::vector<int>& out)
+    {
+        out.clear();
+        std::size_t pos = 0;
+        while (pos <= spec.size())
+        {
+            std::size_t comma = spec.find(',', pos);
+            int n = std::atoi(spec.substr(pos, comma - pos).c_str());
+            if (n <= 0) return false;
+            out.push_back(n);
+            if (comma == std::string::npos) break;
+            pos = comma + 1;
+        }
+        return !out.empty();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::vector<int> threads = {1, 2, 4, 8};
+    long ops = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool ok = true;
+        if (arg.rfind("--filter=", 0) == 0)
+            filter = arg.substr(9);
+        else if (arg.rfind("--threads=", 0) == 0)
+            ok = parseThreads(arg.substr(10), threads);
+        else if (arg.rfind("--ops=", 0) == 0)
+            ok = (ops = std::atol(arg.c_str() + 6)) > 0;
+        else
+            ok = false;
+        if (!ok)
+        {
+            std::fprintf(stderr, "usage: %s [--filter=SUBSTR] [--threads=1,2,4,8] [--ops=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("%-16s %7s %12s %10s %10s %8s\n", "benchmark", "threads", "ns/op", "allocs/op",
+                "Mops/s", "scaling");
+    for (const Benchmark& b : kBenchmarks)
+    {
+        if (!filter.empty() && std::string(b.name).find(filter) == std::string::npos) continue;
+
+        double base = 0;
+        for (int t : threads)
+        {
+            Sample s = b.fn(t, ops > 0 ? ops : b.default_ops);
+            if (base == 0) base = s.mops;
+            std::printf("%-16s %7d %12.1f %10.2f %10.3f %7.2fx\n", b.name, t, s.ns_per_op,
+                        s.allocs_per_op, s.mops, s.mops / base);
+            std::fflush(stdout);
+        }
+    }
+    return 0;
+}
\ No newline at end of file
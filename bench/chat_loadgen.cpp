@@ -0,0 +1,603 @@
+// Load generator: drives N simulated clients against a running ChatServer and
+// reports throughput and end-to-end delivery latency as JSON.
+//
+// Every client registers (or logs in) and joins one of --groups groups, then the
+// generator issues a weighted mix of broadcast, /to, /group and /history at a
+// fixed total rate. Messages carry their send time, so each delivery seen by
+// any client is one latency sample (the generator and server share a host and
+// CLOCK_MONOTONIC). /history is timed from request to reply header.
+//
+// Usage: chat_loadgen [--host=127.0.0.1] [--port=12345] [--clients=100]
+//                     [--rate=1000] [--duration=10] [--size=64] [--groups=4]
+//                     [--mix=broadcast:70,to:20,group:5,history:5]
+//                     [--setup-timeout=30] [--out=FILE]
+
+#include "../includes/Config.hpp"
+#include "../includes/Metrics.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    enum Op
+    {
+        kBroadcast,
+        kTo,
+        kGroup,
+        kHistory,
+        kOps
+    };
+
+    const char* const kOpNames[kOps] = {"broadcast", "to", "group", "history"};
+
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = Config::SERVER_PORT;
+        int clients = 100;
+        double rate = 1000; ///< Total operations per second
+        double duration = 10;
+        std::size_t size = 64; ///< Chat payload bytes
+        int groups = 4;
+        int weights[kOps] = {70, 20, 5, 5};
+        double setup_timeout = 30;
+        std::string out;
+    };
+
+    /// Log-linear latency histogram sharing the server's bucket layout.
+    struct Histogram
+    {
+        std::vector<std::uint64_t> buckets = std::vector<std::uint64_t>(Metrics::kBuckets);
+        std::uint64_t count = 0;
+        std::uint64_t max_ns = 0;
+
+        void add(std::uint64_t ns)
+        {
+            ++buckets[Metrics::bucketFor(ns)];
+            ++count;
+            max_ns = std::max(max_ns, ns);
+        }
+
+        double quantileUs(double q) const
+        {
+            if (count == 0) return 0;
+            auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < buckets.size(); ++i)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return static_cast<double>(std::min(Metrics::bucketUpperBound(i), max_ns)) / 1e3;
+            }
+            return static_cast<double>(max_ns) / 1e3;
+        }
+    };
+
+    enum class State
+    {
+        Connecting,
+        LoggingIn,
+        Grouping,
+        Ready,
+        Closed
+    };
+
+    struct Client
+    {
+        int fd = -1;
+        int index = 0;
+        State state = State::Connecting;
+        std::string name;
+        std::string group;
+        std::string in;
+        std::string out;
+        bool want_write = false;
+        std::deque<std::uint64_t> history_sent; ///< Send times of unanswered /history
+    };
+
+    struct Stats
+    {
+        std::uint64_t sent[kOps] = {};
+        std::uint64_t delivered[kOps] = {};
+        Histogram latency[kOps];
+        std::uint64_t throttled = 0; ///< Ops skipped because a client's send buffer was full
+        std::uint64_t busy = 0;      ///< "Server busy" replies
+        std::uint64_t disconnects = 0;
+        std::uint64_t bytes_in = 0;
+        std::uint64_t bytes_out = 0;
+    };
+
+    constexpr std::size_t kMaxPendingOut = 64 * 1024;
+
+    bool parseMix(const std::string& spec, int (&weights)[kOps])
+    {
+        std::fill(std::begin(weights), std::end(weights), 0);
+        std::size_t pos = 0;
+        while (pos < spec.size())
+        {
+            std::size_t comma = spec.find(',', pos);
+            std::string item = spec.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            std::size_t colon = item.find(':');
+            if (colon == std::string::npos) return false;
+            std::string name = item.substr(0, colon);
+            int w = std::atoi(item.c_str() + colon + 1);
+            int op = 0;
+            while (op < kOps && name != kOpNames[op]) ++op;
+            if (op == kOps || w < 0) return false;
+            weights[op] = w;
+            if (comma == std::string::npos) break;
+            pos = comma + 1;
+        }
+        int total = 0;
+        for (int w : weights) total += w;
+        return total > 0;
+    }
+
+    bool parseArgs(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            std::size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) return false;
+            std::string key = arg.substr(2, eq - 2);
+            std::string val = arg.substr(eq + 1);
+
+            if (key == "host") o.host = val;
+            else if (key == "port") o.port = std::atoi(val.c_str());
+            else if (key == "clients") o.clients = std::atoi(val.c_str());
+            else if (key == "rate") o.rate = std::atof(val.c_str());
+            else if (key == "duration") o.duration = std::atof(val.c_str());
+            else if (key == "size") o.size = static_cast<std::size_t>(std::atol(val.c_str()));
+            else if (key == "groups") o.groups = std::atoi(val.c_str());
+            else if (key == "mix") { if (!parseMix(val, o.weights)) return false; }
+            else if (key == "setup-timeout") o.setup_timeout = std::atof(val.c_str());
+            else if (key == "out") o.out = val;
+            else return false;
+        }
+        return o.port > 0 && o.clients > 0 && o.rate > 0 && o.duration > 0 && o.groups > 0;
+    }
+
+    void raiseFdLimit(int needed)
+    {
+        rlimit rl{};
+        if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+        rlim_t want = static_cast<rlim_t>(needed) + 64;
+        if (rl.rlim_cur >= want) return;
+        rl.rlim_cur = std::min(want, rl.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &rl);
+        if (rl.rlim_cur < want)
+            std::fprintf(stderr, "warning: RLIMIT_NOFILE %llu is below %d clients\n",
+                         static_cast<unsigned long long>(rl.rlim_cur), needed);
+    }
+
+    class LoadGen
+    {
+    public:
+        explicit LoadGen(const Options& o) : opt_(o), rng_(std::random_device{}())
+        {
+            epfd_ = epoll_create1(0);
+            run_tag_ = std::to_string(getpid() % 100000);
+            for (int w : opt_.weights) weight_total_ += w;
+        }
+
+        ~LoadGen()
+        {
+            for (auto& c : clients_)
+                if (c.fd >= 0) ::close(c.fd);
+            if (epfd_ >= 0) ::close(epfd_);
+        }
+
+        int run()
+        {
+            if (!connectAll()) return 1;
+
+            // Setup: register, log in and join a group
+            std::uint64_t deadline = Metrics::nowNs() + seconds(opt_.setup_timeout);
+            while (ready_ + closed_ < clients_.size() && Metrics::nowNs() < deadline)
+                poll(10);
+            std::fprintf(stderr, "setup: %zu/%zu clients ready\n", ready_, clients_.size());
+            if (ready_ == 0) return 1;
+            for (auto& c : clients_)
+                if (c.state == State::Ready) ready_list_.push_back(&c);
+
+            // Measured phase
+            stats_ = Stats{};
+            std::uint64_t start = Metrics::nowNs();
+            std::uint64_t end = start + seconds(opt_.duration);
+            std::uint64_t issued = 0;
+            std::size_t next = 0;
+            while (Metrics::nowNs() < end)
+            {
+                double elapsed = static_cast<double>(Metrics::nowNs() - start) / 1e9;
+                auto due = static_cast<std::uint64_t>(opt_.rate * elapsed);
+                for (; issued < due; ++issued)
+                {
+                    Client& c = *ready_list_[next++ % ready_list_.size()];
+                    issue(c);
+                }
+                poll(1);
+            }
+            double elapsed = static_cast<double>(Metrics::nowNs() - start) / 1e9;
+
+            // Let in-flight deliveries land (not counted in the elapsed time)
+            std::uint64_t drain = Metrics::nowNs() + seconds(2);
+            while (Metrics::nowNs() < drain)
+                poll(10);
+
+            report(elapsed);
+            return 0;
+        }
+
+    private:
+        static std::uint64_t seconds(double s) { return static_cast<std::uint64_t>(s * 1e9); }
+
+        bool connectAll()
+        {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<std::uint16_t>(opt_.port));
+            if (inet_pton(AF_INET, opt_.host.c_str(), &addr.sin_addr) != 1)
+            {
+                std::fprintf(stderr, "bad host %s\n", opt_.host.c_str());
+                return false;
+            }
+
+            raiseFdLimit(opt_.clients);
+            clients_.resize(static_cast<std::size_t>(opt_.clients));
+            for (int i = 0; i < opt_.clients; ++i)
+            {
+                Client& c = clients_[static_cast<std::size_t>(i)];
+                c.index = i;
+                c.name = "lg" + run_tag_ + "_" + std::to_string(i);
+                c.group = "lgg" + run_tag_ + "_" + std::to_string(i % opt_.groups);
+                c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+                if (c.fd == -1)
+                {
+                    perror("socket");
+                    return false;
+                }
+                int one = 1;
+                setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                if (::connect(c.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 &&
+                    errno != EINPROGRESS)
+                {
+                    perror("connect");
+                    return false;
+                }
+
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.u32 = static_cast<std::uint32_t>(i);
+                epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+                c.want_write = true;
+
+                // Keep the server's accept backlog from overflowing
+                if (i % 100 == 99) poll(0);
+            }
+            return true;
+        }
+
+        void poll(int timeout_ms)
+        {
+            epoll_event events[256];
+            int n = epoll_wait(epfd_, events, 256, timeout_ms);
+            for (int i = 0; i < n; ++i)
+            {
+                Client& c = clients_[events[i].data.u32];
+                if (c.state == State::Closed) continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    close(c);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT)
+                {
+                    if (c.state == State::Connecting)
+                    {
+                        c.state = State::LoggingIn;
+                        send(c, "/reg " + c.name + " secret1\r\n");
+                    }
+                    flush(c);
+                }
+                if ((events[i].events & EPOLLIN) && c.state != State::Closed)
+                    readFrom(c);
+            }
+        }
+
+        void send(Client& c, const std::string& data)
+        {
+            if (c.state == State::Closed) return;
+            c.out += data;
+            flush(c);
+        }
+
+        void flush(Client& c)
+        {
+            while (!c.out.empty())
+            {
+                ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+                if (n < 0)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                    close(c);
+                    return;
+                }
+                stats_.bytes_out += static_cast<std::uint64_t>(n);
+                c.out.erase(0, static_cast<std::size_t>(n));
+            }
+
+            bool want = !c.out.empty() || c.state == State::Connecting;
+            if (want != c.want_write)
+            {
+                epoll_event ev{};
+                ev.events = EPOLLIN | (want ? static_cast<std::uint32_t>(EPOLLOUT) : 0u);
+                ev.data.u32 = static_cast<std::uint32_t>(c.index);
+                epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+                c.want_write = want;
+            }
+        }
+
+        void readFrom(Client& c)
+        {
+            char buf[16384];
+            while (true)
+            {
+                ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+                if (n == 0)
+                {
+                    close(c);
+                    return;
+                }
+                if (n < 0)
+                {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) close(c);
+                    break;
+                }
+                stats_.bytes_in += static_cast<std::uint64_t>(n);
+                c.in.append(buf, static_cast<std::size_t>(n));
+            }
+            if (c.state == State::Closed) return;
+
+            std::size_t start = 0, nl;
+            while (c.state != State::Closed && (nl = c.in.find('\n', start)) != std::string::npos)
+            {
+                onLine(c, std::string_view(c.in).substr(start, nl - start));
+                start = nl + 1;
+            }
+            c.in.erase(0, start);
+        }
+
+        void onLine(Client& c, std::string_view line)
+        {
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+            if (c.state == State::LoggingIn)
+            {
+                if (line.rfind("Username already taken", 0) == 0)
+                {
+                    send(c, "/login " + c.name + " secret1\r\n");
+                }
+                else if (line.rfind("Registered as", 0) == 0 || line.rfind("Logged in as", 0) == 0)
+                {
+                    c.state = State::Grouping;
+                    send(c, "/create " + c.group + "\r\n");
+                }
+                else if (line.rfind("Login failed", 0) == 0)
+                {
+                    close(c);
+                }
+                return;
+            }
+            if (c.state == State::Grouping)
+            {
+                if (line.find("already exists") != std::string_view::npos)
+                    send(c, "/join " + c.group + "\r\n");
+                else if (line.find("created & joined") != std::string_view::npos ||
+                         line.rfind("Joined [", 0) == 0 || line.rfind("Already in [", 0) == 0)
+                {
+                    c.state = State::Ready;
+                    ++ready_;
+                }
+                return;
+            }
+
+            std::uint64_t now = Metrics::nowNs();
+            if (line.rfind("=== Recent Messages ===", 0) == 0)
+            {
+                if (!c.history_sent.empty())
+                {
+                    record(kHistory, now - c.history_sent.front());
+                    c.history_sent.pop_front();
+                }
+                return;
+            }
+            if (line.rfind("Server busy", 0) == 0)
+            {
+                ++stats_.busy;
+                if (line.find("/history") != std::string_view::npos && !c.history_sent.empty())
+                    c.history_sent.pop_front();
+                return;
+            }
+            // Deliveries start with '['; history rows start with '#', /to echoes with "[To "
+            if (line.empty() || line[0] != '[' || line.rfind("[To ", 0) == 0) return;
+
+            std::size_t tag = line.find(": LG ");
+            if (tag == std::string_view::npos || tag + 7 >= line.size()) return;
+            char kind = line[tag + 5];
+            std::uint64_t sent = std::strtoull(std::string(line.substr(tag + 7, 20)).c_str(), nullptr, 10);
+            int op = kind == 'b' ? kBroadcast : kind == 'p' ? kTo : kind == 'g' ? kGroup : -1;
+            if (op >= 0 && sent != 0 && sent <= now) record(op, now - sent);
+        }
+
+        void record(int op, std::uint64_t ns)
+        {
+            ++stats_.delivered[op];
+            stats_.latency[op].add(ns);
+        }
+
+        int pickOp()
+        {
+            int r = std::uniform_int_distribution<int>(0, weight_total_ - 1)(rng_);
+            for (int op = 0; op < kOps; ++op)
+            {
+                if (r < opt_.weights[op]) return op;
+                r -= opt_.weights[op];
+            }
+            return kBroadcast;
+        }
+
+        std::string payload(char kind) const
+        {
+            std::string p = "LG ";
+            p += kind;
+            p += ' ';
+            p += std::to_string(Metrics::nowNs());
+            if (p.size() + 1 < opt_.size)
+            {
+                p += ' ';
+                p.append(opt_.size - p.size(), 'x');
+            }
+            return p;
+        }
+
+        void issue(Client& c)
+        {
+            if (c.state != State::Ready) return;
+            if (c.out.size() > kMaxPendingOut)
+            {
+                ++stats_.throttled;
+                return;
+            }
+
+            int op = pickOp();
+            std::string line;
+            switch (op)
+            {
+            case kBroadcast:
+                line = payload('b');
+                break;
+            case kTo:
+            {
+                const Client& to = *ready_list_[std::uniform_int_distribution<std::size_t>(
+                    0, ready_list_.size() - 1)(rng_)];
+                line = "/to " + to.name + " " + payload('p');
+                break;
+            }
+            case kGroup:
+                line = "/group " + c.group + " " + payload('g');
+                break;
+            default:
+                line = "/history 20";
+                c.history_sent.push_back(Metrics::nowNs());
+                break;
+            }
+            ++stats_.sent[op];
+            send(c, line + "\r\n");
+        }
+
+        void close(Client& c)
+        {
+            if (c.state == State::Ready) ++stats_.disconnects;
+            if (c.state == State::Ready && ready_ > 0) --ready_;
+            c.state = State::Closed;
+            epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+            ::close(c.fd);
+            c.fd = -1;
+            ++closed_;
+        }
+
+        void report(double elapsed)
+        {
+            FILE* f = stdout;
+            if (!opt_.out.empty() && !(f = std::fopen(opt_.out.c_str(), "w")))
+            {
+                perror("fopen");
+                f = stdout;
+            }
+
+            std::uint64_t sent = 0, delivered = 0;
+            for (int op = 0; op < kOps; ++op)
+            {
+                sent += stats_.sent[op];
+                delivered += stats_.delivered[op];
+            }
+
+            std::fprintf(f, "{\n  \"config\": {\"clients\": %d, \"ready\": %zu, \"rate\": %.0f, "
+                            "\"duration_s\": %.3f, \"size\": %zu, \"groups\": %d, \"mix\": {",
+                         opt_.clients, ready_list_.size(), opt_.rate, opt_.duration, opt_.size,
+                         opt_.groups);
+            for (int op = 0; op < kOps; ++op)
+                std::fprintf(f, "%s\"%s\": %d", op ? ", " : "", kOpNames[op], opt_.weights[op]);
+            std::fprintf(f, "}},\n");
+            std::fprintf(f, "  \"elapsed_s\": %.3f,\n", elapsed);
+            std::fprintf(f, "  \"throughput\": {\"sent_per_s\": %.1f, \"delivered_per_s\": %.1f, "
+                            "\"bytes_in_per_s\": %.1f, \"bytes_out_per_s\": %.1f},\n",
+                         static_cast<double>(sent) / elapsed, static_cast<double>(delivered) / elapsed,
+                         static_cast<double>(stats_.bytes_in) / elapsed,
+                         static_cast<double>(stats_.bytes_out) / elapsed);
+            std::fprintf(f, "  \"ops\": {\n");
+            for (int op = 0; op < kOps; ++op)
+            {
+                const Histogram& h = stats_.latency[op];
+                std::fprintf(f, "    \"%s\": {\"sent\": %llu, \"delivered\": %llu, \"latency_us\": "
+                                "{\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}}%s\n",
+                             kOpNames[op], static_cast<unsigned long long>(stats_.sent[op]),
+                             static_cast<unsigned long long>(stats_.delivered[op]),
+                             h.quantileUs(0.50), h.quantileUs(0.99), h.quantileUs(0.999),
+                             static_cast<double>(h.max_ns) / 1e3, op + 1 < kOps ? "," : "");
+            }
+            std::fprintf(f, "  },\n");
+            std::fprintf(f, "  \"errors\": {\"throttled\": %llu, \"server_busy\": %llu, "
+                            "\"disconnects\": %llu}\n}\n",
+                         static_cast<unsigned long long>(stats_.throttled),
+                         static_cast<unsigned long long>(stats_.busy),
+                         static_cast<unsigned long long>(stats_.disconnects));
+            if (f != stdout) std::fclose(f);
+        }
+
+        Options opt_;
+        std::mt19937 rng_;
+        int epfd_ = -1;
+        std::string run_tag_;
+        int weight_total_ = 0;
+        std::vector<Client> clients_;
+        std::vector<Client*> ready_list_;
+        std::size_t ready_ = 0;
+        std::size_t closed_ = 0;
+        Stats stats_;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt))
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--host=H] [--port=P] [--clients=N] [--rate=OPS] [--duration=S]\n"
+                     "          [--size=BYTES] [--groups=N] [--mix=broadcast:70,to:20,group:5,history:5]\n"
+                     "          [--setup-timeout=S] [--out=FILE]\n",
+                     argv[0]);
+        return 1;
+    }
+    return LoadGen(opt).run();
+}
\ No newline at end of file
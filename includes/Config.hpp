@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 /**
  * @brief Configuration constants for the chat server application.
@@ -10,14 +11,56 @@ namespace Config
 {
     constexpr int SERVER_PORT = 12345;
     constexpr int LISTEN_BACKLOG = 128;
-    constexpr std::size_t THREAD_POOL_SIZE = 4;
+    constexpr std::size_t THREAD_POOL_SIZE = 0; ///< 0 = one worker per core (hardware_concurrency)
+    constexpr std::size_t TASK_QUEUE_HIGH_WATER = 1024; ///< Pause socket reads above this pool backlog
+    constexpr std::size_t TASK_QUEUE_LOW_WATER = 256;   ///< Resume them once it drains to this
+    constexpr bool SHED_CONNECTIONS = true;  ///< Turn away new clients while overloaded
+    constexpr bool SHED_LOW_PRIORITY = true; ///< Refuse low-priority commands (/history) while overloaded
+    constexpr std::size_t REACTOR_THREADS = 0; ///< 0 = single reactor + ThreadPool; N = N SO_REUSEPORT reactors
+    constexpr bool USE_IO_URING = false;     ///< io_uring backend instead of epoll (--io=uring|epoll overrides)
+    constexpr unsigned URING_ENTRIES = 4096; ///< Submission queue size per reactor
+    constexpr unsigned URING_BUFFERS = 1024; ///< Provided recv buffers per reactor (power of two, RECV_BUFFER_SIZE each)
     constexpr int MAX_EPOLL_EVENTS = 64;
+    constexpr int MAX_EPOLL_WAIT_MS = 1000;         ///< Upper bound on one epoll_wait (shutdown polling)
+    constexpr int TIMER_TICK_MS = 100;              ///< Timer wheel resolution
+    constexpr std::size_t TIMER_WHEEL_SLOTS = 1024; ///< Buckets per revolution (~102 s)
+    constexpr int IDLE_TIMEOUT_MS = 0;              ///< Close silent text clients after this (0 = never)
+    constexpr int HEARTBEAT_INTERVAL_MS = 30000;    ///< Ping silent binary clients after this (0 = off)
+    constexpr int HEARTBEAT_TIMEOUT_MS = 10000;     ///< ...and close them if the ping goes unanswered
+    constexpr int TCP_KEEPALIVE_IDLE_S = 60;        ///< Kernel probes a quiet connection after this (0 = off)
+    constexpr int TCP_KEEPALIVE_INTERVAL_S = 10;    ///< ...every this many seconds
+    constexpr int TCP_KEEPALIVE_PROBES = 6;         ///< ...and drops it after this many go unanswered
+    constexpr int TCP_USER_TIMEOUT_MS = 120000;     ///< Drop a peer that leaves sent data unacknowledged this long (0 = kernel default)
     constexpr int RECV_BUFFER_SIZE = 4096;
+    constexpr std::size_t MAX_LINE_LENGTH = 64 * 1024; ///< Longer input lines are dropped
+    constexpr std::size_t MAX_OUTBOUND_BYTES = 4 * 1024 * 1024; ///< Per-connection send queue cap
     constexpr int DEFAULT_HISTORY = 50;
     constexpr int LOGIN_HISTORY = 10;
+    constexpr int MAX_HISTORY_PAGE = 200; ///< Largest n accepted by /history
     constexpr int USERNAME_MIN_LEN = 2;
     constexpr int USERNAME_MAX_LEN = 20;
     constexpr int PASSWORD_MIN_LEN = 6;
     constexpr int PASSWORD_MAX_LEN = 20;
+    constexpr std::uint32_t PASSWORD_KDF_ITERATIONS = 50000; ///< PBKDF2-SHA256 cost (~30 ms per hash)
+    constexpr std::size_t AUTH_THREADS = 2;      ///< Workers that run the KDF for /reg and /login
+    constexpr std::size_t AUTH_QUEUE_MAX = 256;  ///< Refuse /reg and /login beyond this backlog
+    constexpr std::size_t AUTH_CACHE_SIZE = 4096;  ///< Recently verified logins skipping the KDF (0 = off)
+    constexpr int AUTH_CACHE_TTL_MS = 600000;      ///< How long a cached verification stays valid
     constexpr const char* DB_FILENAME = "chat.db";
+    constexpr std::size_t DB_WRITE_BATCH = 512;  ///< Max rows per write-behind transaction
+    constexpr int DB_FLUSH_INTERVAL_MS = 20;     ///< Max time a queued message waits for commit
+    constexpr std::size_t DB_READER_POOL = 4;    ///< Read-only SQLite connections for lookups
+    constexpr std::size_t HISTORY_CACHE_SIZE = 1024; ///< Recent messages kept in memory for /history
+    constexpr int OFFLINE_QUEUE_MAX = 1000;        ///< Private messages held per offline user
+    constexpr int RETENTION_DAYS = 0;              ///< Prune messages older than this (0 = keep forever)
+    constexpr std::size_t RETENTION_MAX_ROWS = 0;  ///< Prune beyond this many messages (0 = no cap)
+    constexpr const char* ARCHIVE_DIR = "";        ///< Pruned rows go to per-day .tsv.gz files here ("" = discard)
+    constexpr std::size_t RETENTION_BATCH = 500;   ///< Rows deleted per transaction while pruning
+    constexpr int RETENTION_INTERVAL_MS = 60000;   ///< Time between retention passes
+    constexpr int MAINTENANCE_INTERVAL_MS = 1000;  ///< Time between WAL checkpoints / vacuum steps
+    constexpr int WAL_TRUNCATE_INTERVAL_MS = 60000; ///< Min time between WAL truncations
+    constexpr std::int64_t WAL_SIZE_LIMIT = 64LL * 1024 * 1024; ///< journal_size_limit: WAL bytes kept on reuse
+    constexpr int VACUUM_PAGES = 256;              ///< Free pages returned to the OS per step
+    constexpr const char* ADMIN_USER = "admin";                   ///< Only this account may run /stats
+    constexpr const char* METRICS_SOCKET_PATH = "chatx-metrics.sock"; ///< Prometheus endpoint ("" = off)
 }
\ No newline at end of file
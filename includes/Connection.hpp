@@ -0,0 +1,78 @@
+#pragma once
+
+#include "LineBuffer.hpp"
+#include "Protocol.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
+
+/// Immutable, reference-counted payload shared by every recipient of a fan-out.
+using OutBuffer = std::shared_ptr<const std::string>;
+
+/**
+ * @brief Per-socket I/O state owned by the reactor that accepted it.
+ *
+ * ClientSession holds auth state and is copied out of UserManager;
+ * a Connection is shared by pointer, so a task posted to another
+ * reactor can tell whether the socket it targets is still alive.
+ */
+class Connection : public std::enable_shared_from_this<Connection>
+{
+public:
+    int fd;                   ///< Socket file descriptor
+    int reactor_id;           ///< Index of the owning reactor
+    std::atomic<bool> closed; ///< Set once by the first disconnect
+
+    LineBuffer in_buf; ///< Received bytes; only the running strand touches it
+
+    /// Set once by the strand from the first bytes received; read by any sender.
+    std::atomic<Protocol::WireMode> mode;
+
+    // ── Liveness (timer fields are owned by the reactor) ────────────
+
+    std::atomic<std::int64_t> last_activity_ms; ///< Monotonic time of the last bytes received
+    std::int64_t timer_deadline_ms;             ///< Current TimerWheel deadline
+    std::int64_t ping_sent_ms;                  ///< Last heartbeat sent (0 = none outstanding)
+
+    // ── I/O state (guarded by io_mtx) ───────────────────────────────
+
+    std::mutex io_mtx;
+    std::deque<OutBuffer> out_queue; ///< Buffers the socket would not take yet
+    std::size_t out_offset;          ///< Bytes of out_queue.front() already sent
+    std::size_t out_bytes;           ///< Unsent bytes across the whole queue
+    bool want_write;                 ///< Output is pending, EPOLLOUT wanted
+
+    /// A strand (input handler) is running; with epoll the fd is closed by it, not by close_connection().
+    bool in_flight;
+    bool paused; ///< Reads held back while the server is overloaded
+    std::uint32_t armed_events; ///< Mask currently registered with epoll (0 = disarmed)
+
+    // ── Auth hand-off ───────────────────────────────────────────────
+
+    /// A /reg or /login is on the auth executor; later input waits for its verdict.
+    std::atomic<bool> auth_pending;
+    bool auth_parked; ///< The strand stopped for auth and keeps in_flight; the auth task resumes it (io_mtx)
+    bool input_held;  ///< in_buf still holds complete input held back for auth (strand only)
+
+    // ── io_uring backend (unused with epoll) ────────────────────────
+
+    std::string rx_pending; ///< Bytes received by the reactor, not yet framed (io_mtx)
+    std::string rx_spare;   ///< Strand's swap partner for rx_pending, keeps its capacity
+    bool rx_eof;            ///< Peer closed while a strand was running (io_mtx)
+    bool rx_throttled;      ///< Recv cancelled until the strand catches up (io_mtx)
+    bool send_scheduled;    ///< On the reactor's send list or a send is in flight (io_mtx)
+    bool send_inflight;     ///< A SENDMSG awaits its completion (reactor only)
+    bool recv_armed;        ///< A multishot recv is outstanding (reactor only)
+    std::vector<iovec> send_iov; ///< Buffers of the in-flight SENDMSG
+    msghdr send_msg;             ///< Must outlive the SENDMSG it was submitted with
+
+    Connection(int fd, int reactor_id);
+};
\ No newline at end of file
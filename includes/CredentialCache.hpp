@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Crypto.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Remembers recently verified logins so reconnects skip the KDF.
+ *
+ * Holds, per username, an HMAC of the password under a key drawn at
+ * startup, never the password or its stored hash. A hit therefore costs
+ * one HMAC instead of a full PBKDF2 run. Entries expire after a fixed
+ * time and the least recently used one is evicted when full. All
+ * methods are thread-safe.
+ */
+class CredentialCache
+{
+public:
+    /**
+     * @param capacity Max users remembered (0 disables the cache).
+     * @param ttl_ms   How long a verification stays valid.
+     */
+    CredentialCache(std::size_t capacity, std::int64_t ttl_ms);
+
+    /// @brief true if @p password was verified for @p username within the TTL.
+    bool check(const std::string& username, const std::string& password);
+
+    /// @brief Record a successful verification (or registration).
+    void remember(const std::string& username, const std::string& password);
+
+    /// @brief Drop @p username, e.g. after its stored hash changed.
+    void forget(const std::string& username);
+
+    std::uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    std::uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry
+    {
+        Crypto::Digest tag;
+        std::int64_t expires_ms;
+        std::list<std::string>::iterator lru; ///< Position in lru_ (front = newest)
+    };
+
+    Crypto::Digest tagFor(const std::string& username, const std::string& password) const;
+
+    std::size_t capacity_; ///< 0 when disabled
+    const std::int64_t ttl_ms_;
+    std::string key_; ///< Per-process HMAC key
+
+    std::mutex mtx_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;
+
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+};
\ No newline at end of file
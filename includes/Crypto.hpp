@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief The few primitives password storage needs, implemented in-tree.
+ *
+ * SHA-256 (FIPS 180-4), HMAC-SHA256 (RFC 2104) and PBKDF2-HMAC-SHA256
+ * (RFC 8018), plus kernel randomness and hex helpers. Nothing here is
+ * tuned for bulk hashing: the KDF is meant to be slow.
+ */
+namespace Crypto
+{
+    constexpr std::size_t DIGEST_SIZE = 32;
+    using Digest = std::array<std::uint8_t, DIGEST_SIZE>;
+
+    /// @brief Incremental SHA-256.
+    class Sha256
+    {
+    public:
+        Sha256();
+
+        void update(const void* data, std::size_t len);
+        void update(std::string_view s) { update(s.data(), s.size()); }
+
+        /// @brief Pad, and write the digest to @p out. The object is spent afterwards.
+        void finish(std::uint8_t* out);
+
+    private:
+        void compress(const std::uint8_t* block);
+
+        std::uint32_t state_[8];
+        std::uint8_t block_[64];
+        std::size_t fill_ = 0;    ///< Bytes buffered in block_
+        std::uint64_t total_ = 0; ///< Bytes hashed so far
+    };
+
+    Digest sha256(std::string_view data);
+
+    Digest hmacSha256(std::string_view key, std::string_view message);
+
+    /**
+     * @brief PBKDF2-HMAC-SHA256.
+     * @param iterations Cost: each one is two SHA-256 compressions per output block.
+     * @param out        Receives @p out_len derived bytes.
+     */
+    void pbkdf2Sha256(std::string_view password, std::string_view salt, std::uint32_t iterations,
+                      std::uint8_t* out, std::size_t out_len);
+
+    /// @brief Fill @p out from the kernel CSPRNG (getrandom). @return false if it failed.
+    bool randomBytes(void* out, std::size_t len);
+
+    std::string toHex(const std::uint8_t* data, std::size_t len);
+
+    /// @brief Decode lowercase/uppercase hex. @return false on odd length or a bad digit.
+    bool fromHex(std::string_view hex, std::string& out);
+
+    /// @brief Compare without an early exit, so timing reveals nothing about the match.
+    bool constantTimeEqual(const std::uint8_t* a, const std::uint8_t* b, std::size_t len);
+}
\ No newline at end of file
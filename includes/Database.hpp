@@ -1,75 +1,340 @@
-#pragma once
-#include "Message.hpp"
-
-#include <mutex>
-#include <sqlite3.h>
-#include <string>
-#include <vector>
-
-/**
- * @brief Manages all SQLite operations with internal mutex protection.
- *
- * The database is opened once at startup via open() and closed on destruction.
- * All public methods are thread-safe.
- */
-class Database
-{
-public:
-    Database();
-    ~Database();
-
-    Database(const Database&) = delete;
-    Database& operator=(const Database&) = delete;
-
-    /**
-     * @brief Open the database file and initialise tables.
-     * @param db_filename Path to the SQLite file.
-     * @return true on success.
-     */
-    bool open(const std::string& db_filename);
-
-    /// @brief Close the database handle (idempotent).
-    void close();
-
-    // ── Message operations ──────────────────────────────────────────
-
-    /**
-     * @brief Insert a chat message.
-     * @return true on success.
-     */
-    bool insertMessage(const std::string& sender,
-                       const std::string& receiver,
-                       const std::string& content,
-                       const std::string& type);
-
-    /**
-     * @brief Fetch the N most recent messages.
-     * @param limit Max number of rows (default 50).
-     */
-    std::vector<ChatMessage> getRecentMessages(int limit = 50) const;
-
-    // ── User operations ─────────────────────────────────────────────
-
-    /**
-     * @brief Persist a new user (username + hashed password).
-     * @return true on success, false if username already exists.
-     */
-    bool insertUser(const std::string& username, const std::string& password_hash);
-
-    /**
-     * @brief Look up the stored password hash for a username.
-     * @param[out] out_hash Receives the hash if found.
-     * @return true if user exists.
-     */
-    bool getUserPasswordHash(const std::string& username, std::string& out_hash) const;
-
-    /// @brief Check whether a username exists in the DB.
-    bool userExists(const std::string& username) const;
-
-private:
-    sqlite3* db;            ///< SQLite handle (nullptr when closed)
-    mutable std::mutex mtx; ///< Protects all database operations
-
-    /// @brief Create tables if they don't exist.
-    bool initTables();
+#pragma once
+#include "Config.hpp"
+#include "HistoryCache.hpp"
+#include "Message.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Manages all SQLite operations with internal mutex protection.
+ *
+ * The database is opened once at startup via open() and closed on destruction.
+ * Message inserts are write-behind: callers push onto a lock-free queue and a
+ * dedicated writer thread commits them in batches. Writes go through one
+ * connection behind @c mtx; lookups lease one of a pool of read-only
+ * connections so they run concurrently with writes under WAL.
+ * All public methods are thread-safe.
+ */
+class Database
+{
+public:
+    Database();
+    ~Database();
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    /**
+     * @brief Open the database file, initialise tables and start the writer.
+     * @param db_filename       Path to the SQLite file.
+     * @param write_batch       Max rows committed per transaction.
+     * @param flush_interval_ms Max time a queued message waits before commit.
+     * @param reader_pool       Read-only connections to open (0 = read on the writer).
+     * @return true on success.
+     */
+    bool open(const std::string& db_filename,
+              std::size_t write_batch = Config::DB_WRITE_BATCH,
+              int flush_interval_ms = Config::DB_FLUSH_INTERVAL_MS,
+              std::size_t reader_pool = Config::DB_READER_POOL);
+
+    /// @brief Flush pending messages, stop the writer and close the handle (idempotent).
+    void close();
+
+    // ── Message operations ──────────────────────────────────────────
+
+    /**
+     * @brief Queue a chat message for the background writer.
+     *
+     * Returns immediately; the row is committed within the flush interval.
+     * @return true if the message was queued (database is open).
+     */
+    bool insertMessage(const std::string& sender,
+                       const std::string& receiver,
+                       const std::string& content,
+                       const std::string& type);
+
+    /// @brief Block until every message queued so far has been committed.
+    void flush();
+
+    /**
+     * @brief Fetch the N most recent messages.
+     *
+     * Served from the in-memory HistoryCache when it holds them all;
+     * only falls through to SQLite on a miss.
+     * @param limit Max number of rows (default 50).
+     */
+    std::vector<ChatMessage> getRecentMessages(int limit = 50) const;
+
+    /**
+     * @brief Fetch one page of the messages @p viewer is allowed to see.
+     *
+     * Visibility is resolved in SQL: one indexed range scan per source
+     * (broadcasts, private messages sent / received, each of @p groups),
+     * so the cost depends on the page size rather than the table size.
+     * Served from the HistoryCache when the ring can answer on its own.
+     * @param viewer    Username whose private messages are included.
+     * @param groups    Groups whose messages are included.
+     * @param limit     Page size.
+     * @param before_id Only return ids below this cursor (0 = newest page).
+     * @return Up to @p limit messages, newest first.
+     */
+    std::vector<ChatMessage> getVisibleMessages(const std::string& viewer,
+                                                const std::vector<std::string>& groups,
+                                                int limit,
+                                                std::int64_t before_id = 0) const;
+
+    /// @brief Ring cache in front of getRecentMessages() (for hit/miss stats).
+    const HistoryCache& historyCache() const { return history_cache_; }
+
+    /// @brief Messages accepted by insertMessage() but not yet committed.
+    std::size_t pendingWrites() const { return pending_count_.load(std::memory_order_relaxed); }
+
+    // ── User operations ─────────────────────────────────────────────
+
+    /**
+     * @brief Persist a new user (username + hashed password).
+     * @return true on success, false if username already exists.
+     */
+    bool insertUser(const std::string& username, const std::string& password_hash);
+
+    /**
+     * @brief Look up the stored password hash for a username.
+     * @param[out] out_hash Receives the hash if found.
+     * @return true if user exists.
+     */
+    bool getUserPasswordHash(const std::string& username, std::string& out_hash) const;
+
+    /// @brief Replace a user's stored hash (upgrading legacy or cheaper hashes on login).
+    bool updateUserPasswordHash(const std::string& username, const std::string& password_hash);
+
+    /// @brief Check whether a username exists in the DB.
+    bool userExists(const std::string& username) const;
+
+    // ── Group operations ────────────────────────────────────────────
+
+    /// @brief A persisted group and its members' usernames.
+    struct GroupRecord
+    {
+        std::int64_t id;
+        std::string name;
+        std::vector<std::string> members;
+    };
+
+    /**
+     * @brief Persist a new group.
+     * @return Its id, or 0 if the name is taken (or the write failed).
+     */
+    std::int64_t insertGroup(const std::string& name);
+
+    /// @brief Persist a membership. @return false if @p username already belongs to the group.
+    bool insertGroupMember(std::int64_t group_id, const std::string& username);
+
+    /// @brief Every group with its members, for UserManager's index at startup.
+    std::vector<GroupRecord> loadGroups() const;
+
+    // ── Offline delivery ────────────────────────────────────────────
+
+    enum class OfflineResult
+    {
+        Queued,
+        UnknownUser,
+        QueueFull, ///< OFFLINE_QUEUE_MAX messages already wait for the receiver
+        Closed,
+    };
+
+    /**
+     * @brief Store a private message for @p receiver's next login.
+     *
+     * Like insertMessage(), plus an offline_queue row in the same
+     * transaction. The cap counts messages still in the write-behind
+     * queue, and concurrent senders to one receiver are checked one at a time.
+     */
+    OfflineResult queueOfflineMessage(const std::string& sender,
+                                      const std::string& receiver,
+                                      const std::string& content);
+
+    /**
+     * @brief Every message queued for @p username, oldest first.
+     *
+     * Merges committed rows with those still waiting for the writer, so a
+     * message sent just before the login is included without a flush.
+     */
+    std::vector<ChatMessage> offlineMessages(const std::string& username) const;
+
+    /// @brief Remove delivered messages from @p username's queue in one transaction.
+    void markOfflineDelivered(const std::string& username, const std::vector<ChatMessage>& delivered);
+
+    // ── Maintenance (see Maintenance.hpp) ───────────────────────────
+
+    /**
+     * @brief First message id the retention policy keeps.
+     * @param min_timestamp_ms Drop rows stamped earlier, and every id below the
+     *                         newest of them (0 = no age limit).
+     * @param max_rows         Keep at most this many of the newest rows (0 = no cap).
+     *                         Ids have gaps, so this walks max_rows primary key entries.
+     * @return Rows with smaller ids should go (1 = nothing to prune).
+     */
+    std::int64_t retentionCutoff(std::int64_t min_timestamp_ms, std::size_t max_rows) const;
+
+    /// @brief Last id of the next prune batch: the @p limit oldest rows below @p before_id (0 = none).
+    std::int64_t pruneBatchEnd(std::int64_t before_id, std::size_t limit) const;
+
+    /// @brief Every message with id <= @p last_id, oldest first (for archiving a batch).
+    std::vector<ChatMessage> messagesThrough(std::int64_t last_id) const;
+
+    /// @brief Delete messages with id <= @p last_id in one transaction. @return Rows deleted.
+    std::size_t deleteMessagesThrough(std::int64_t last_id);
+
+    /**
+     * @brief Checkpoint the WAL without waiting on readers or the writer.
+     *
+     * Uses a connection of its own, so the writer keeps appending meanwhile.
+     * A passive checkpoint never shrinks the WAL file; see truncateWal().
+     * @return true if the WAL is non-empty and every frame was copied.
+     */
+    bool checkpoint();
+
+    /// @brief Reset the WAL and truncate its file, or give up at once if readers still use it.
+    void truncateWal();
+
+    /// @brief Stop (0) or resume SQLite's checkpoint-on-commit every @p pages WAL pages.
+    void setWalAutoCheckpoint(int pages);
+
+    /// @brief Return up to @p pages free pages to the filesystem (incremental auto_vacuum only).
+    void incrementalVacuum(int pages);
+
+private:
+    /// Intrusive node of the write-behind queue.
+    struct PendingMessage
+    {
+        ChatMessage msg;
+        bool offline = false; ///< Also goes into offline_queue
+        PendingMessage* next = nullptr;
+    };
+
+    /**
+     * @brief One SQLite connection plus the statements prepared on it.
+     *
+     * Statements are keyed by the address of their (static) SQL text,
+     * prepared on first use and reset for every later use.
+     */
+    struct DbHandle
+    {
+        sqlite3* db = nullptr;
+        std::unordered_map<const char*, sqlite3_stmt*> stmts;
+
+        /// @brief Cached statement for @p sql, reset with bindings cleared.
+        sqlite3_stmt* prepare(const char* sql);
+
+        /// @brief Finalize every cached statement and close the connection.
+        void close();
+    };
+
+    DbHandle writer_;       ///< Read-write connection (db == nullptr when closed)
+    mutable std::mutex mtx; ///< Protects writer_
+
+    DbHandle checkpointer_;        ///< Runs checkpoint() off the writer (file databases only)
+    std::mutex checkpointer_mtx_;  ///< Protects checkpointer_
+
+
+    // ── Reader pool ─────────────────────────────────────────────────
+
+    std::vector<DbHandle> readers_;               ///< Read-only connections
+    mutable std::vector<DbHandle*> idle_readers_; ///< Free list (guarded by reader_mtx_)
+    mutable std::mutex reader_mtx_;
+    mutable std::condition_variable reader_cv_;
+
+    /**
+     * @brief Run @p fn with a read connection leased for the call.
+     *
+     * Falls back to the writer connection (under @c mtx) when no pool
+     * is open, e.g. for in-memory databases.
+     */
+    template <typename Fn>
+    auto withReader(Fn&& fn) const;
+
+    HistoryCache history_cache_{Config::HISTORY_CACHE_SIZE};
+    std::mutex sequence_mtx_;          ///< Keeps id order and ring order identical
+    std::int64_t next_message_id_ = 1; ///< Next row id (guarded by sequence_mtx_)
+
+    // ── Write-behind stage ──────────────────────────────────────────
+
+    std::atomic<PendingMessage*> pending_head_{nullptr}; ///< MPSC stack, newest first
+    std::atomic<std::size_t> pending_count_{0};
+    std::atomic<std::uint64_t> enqueued_{0};  ///< Messages pushed so far
+    std::atomic<std::uint64_t> committed_{0}; ///< Messages the writer has finished with
+    std::atomic<bool> accepting_{false};      ///< insertMessage() allowed
+    std::atomic<bool> writer_stop_{false};
+
+    std::mutex writer_mtx_;              ///< Pairs with the two condition variables
+    std::condition_variable writer_cv_;  ///< Wakes the writer (first message / batch full / stop / flush)
+    std::condition_variable flushed_cv_; ///< Signalled after every committed batch
+    int flush_waiters_ = 0;              ///< Threads blocked in flush() (guarded by writer_mtx_)
+
+    std::size_t write_batch_ = Config::DB_WRITE_BATCH;
+    int flush_interval_ms_ = Config::DB_FLUSH_INTERVAL_MS;
+    std::thread writer_thread_;
+
+    /// @brief Create tables if they don't exist.
+    bool initTables();
+
+    /// @brief Rewrite a pre-epoch `messages` table (TEXT local-time stamps) in place.
+    bool migrateTimestamps();
+
+    /// @brief getRecentMessages() straight from SQLite.
+    std::vector<ChatMessage> queryRecentMessages(int limit) const;
+
+    /// @brief getVisibleMessages() straight from SQLite.
+    std::vector<ChatMessage> queryVisibleMessages(const std::string& viewer,
+                                                  const std::vector<std::string>& groups,
+                                                  int limit,
+                                                  std::int64_t before_id) const;
+
+    /// @brief Writer thread: drain the queue and commit it batch by batch.
+    void writerLoop();
+
+    /// @brief Wake the writer without losing the notification.
+    void wakeWriter();
+
+    // ── Offline messages not yet written ───────────────────────────
+
+    /// Lock order: mtx → offline_mtx_. Entries leave once committed or delivered.
+    mutable std::mutex offline_mtx_;
+    std::unordered_map<std::string, std::vector<ChatMessage>> offline_unwritten_; ///< receiver → messages
+    /// One queueOfflineMessage() per receiver at a time, so the cap holds; striped by name hash
+    std::array<std::mutex, 64> offline_send_stripes_;
+
+    /// @brief Committed offline_queue rows for @p username, or -1 if no such user.
+    int committedOfflineDepth(const std::string& username) const;
+
+    /**
+     * @brief insertMessage(), optionally also bound for offline_queue.
+     * @param offline Record it in offline_unwritten_ too.
+     */
+    bool enqueueMessage(const std::string& sender, const std::string& receiver,
+                        const std::string& content, const std::string& type, bool offline);
+
+    /**
+     * @brief writeBatch() until it commits, backing off between attempts.
+     *
+     * A batch is only given up once stop() is waiting for the writer.
+     */
+    void commitBatch(const std::vector<ChatMessage>& batch, const std::vector<std::size_t>& offline);
+
+    /**
+     * @brief Insert @p batch inside one transaction. Caller holds mtx.
+     * @param offline Indices into @p batch that also go into offline_queue,
+     *                unless they were delivered before reaching the writer.
+     * @return false if BEGIN or COMMIT failed and nothing was written.
+     */
+    bool writeBatch(const std::vector<ChatMessage>& batch, const std::vector<std::size_t>& offline);
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include "Message.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+/**
+ * @brief Bounded ring of the most recent chat messages.
+ *
+ * Sits in front of the messages table so /history and the login replay
+ * are served from memory. Fed by Database::insertMessage() and warmed
+ * from the table at startup. All methods are thread-safe.
+ */
+class HistoryCache
+{
+public:
+    /// @param capacity Max messages kept (0 disables the cache).
+    explicit HistoryCache(std::size_t capacity);
+
+    /// @brief Append the newest message (ids must arrive in increasing order).
+    void push(const ChatMessage& msg);
+
+    /**
+     * @brief Replace the contents with rows loaded from the database.
+     * @param newest_first Rows ordered newest → oldest (as fetched).
+     * @param complete     true if these are all the rows that exist.
+     */
+    void warm(const std::vector<ChatMessage>& newest_first, bool complete);
+
+    /// @brief Forget messages with ids up to @p last_id (they were pruned from the table).
+    void discardThrough(std::int64_t last_id);
+
+    /**
+     * @brief Copy the @p limit most recent messages accepted by @p visible.
+     *
+     * Scans newest → oldest, skipping ids at or above @p before_id
+     * (0 = no cursor).
+     * @return false (a miss) if the ring cannot prove it holds them all.
+     */
+    template <typename Pred>
+    bool recent(int limit, std::int64_t before_id, Pred&& visible,
+                std::vector<ChatMessage>& out) const;
+
+    std::size_t capacity() const { return capacity_; }
+    std::uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    std::uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    const std::size_t capacity_;
+    mutable std::shared_mutex mtx_;
+    std::vector<ChatMessage> ring_; ///< Fixed-size slots in id order, reused in place
+    std::size_t next_ = 0;          ///< Slot the next push writes
+    std::size_t size_ = 0;          ///< Occupied slots
+    bool complete_ = false;         ///< Ring holds every message ever stored
+
+    mutable std::atomic<std::uint64_t> hits_{0};
+    mutable std::atomic<std::uint64_t> misses_{0};
+};
+
+template <typename Pred>
+bool HistoryCache::recent(int limit, std::int64_t before_id, Pred&& visible,
+                          std::vector<ChatMessage>& out) const
+{
+    std::size_t want = limit > 0 ? static_cast<std::size_t>(limit) : 0;
+    out.clear();
+
+    std::shared_lock lock(mtx_);
+    for (std::size_t i = 1; i <= size_ && out.size() < want; ++i)
+    {
+        const ChatMessage& m = ring_[(next_ + capacity_ - i) % capacity_];
+        if (before_id > 0 && m.id >= before_id) continue;
+        if (visible(m)) out.push_back(m);
+    }
+
+    // Short of the limit is only an answer if nothing older exists
+    if (out.size() < want && !complete_)
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct msghdr;
+
+/**
+ * @brief Minimal io_uring instance driven by raw syscalls (no liburing).
+ *
+ * Owns the submission/completion rings and, optionally, one provided
+ * buffer ring that multishot recv picks its buffers from. Only the
+ * thread that runs the reactor may touch it.
+ *
+ * Lifecycle: init() → setupBufferRing() → prep*() … submitAndWait()
+ * → forEachCompletion() → (repeat).
+ */
+class IoUring
+{
+public:
+    IoUring() = default;
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * @brief Create the rings and check that every operation the server uses exists.
+     * @param entries Submission queue size (rounded up to a power of two).
+     * @param why     Set to the reason when io_uring cannot be used.
+     * @return false if the kernel lacks io_uring or a required feature.
+     */
+    bool init(unsigned entries, std::string& why);
+
+    /**
+     * @brief Register a ring of @p count buffers of @p size bytes as group @p group.
+     * @param count Power of two, at most 32768.
+     */
+    bool setupBufferRing(std::uint16_t group, unsigned count, unsigned size, std::string& why);
+
+    // ── Submission (queued until the next submitAndWait) ────────────
+
+    void prepAcceptMultishot(int fd, std::uint64_t user_data);
+    void prepRecvMultishot(int fd, std::uint16_t group, std::uint64_t user_data);
+    void prepSendmsg(int fd, const msghdr* msg, unsigned flags, std::uint64_t user_data);
+    void prepPollMultishot(int fd, unsigned events, std::uint64_t user_data);
+    void prepCancel(std::uint64_t target, std::uint64_t user_data);
+
+    /**
+     * @brief Submit everything queued and wait for at least one completion.
+     * @param timeout_ms Longest wait (-1 = none).
+     * @return 0 on success or timeout, -errno otherwise.
+     */
+    int submitAndWait(int timeout_ms);
+
+    /// @brief Invoke fn(const io_uring_cqe&) for every ready completion, then release them.
+    template <typename Fn>
+    unsigned forEachCompletion(Fn&& fn);
+
+    // ── Provided buffers ────────────────────────────────────────────
+
+    const char* buffer(std::uint16_t bid) const { return buffers_ + std::size_t(bid) * buffer_size_; }
+
+    /// @brief Hand buffer @p bid back to the kernel once its data has been copied out.
+    void recycleBuffer(std::uint16_t bid);
+
+    /// @brief Buffer id carried by a completion that used a provided buffer.
+    static std::uint16_t bufferId(const io_uring_cqe& cqe)
+    {
+        return static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+
+private:
+    io_uring_sqe* nextSqe();
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, std::size_t argsz);
+    void release();
+
+    int fd_ = -1;
+
+    // Submission ring
+    void* sq_ptr_ = nullptr;
+    std::size_t sq_len_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_len_ = 0;
+    unsigned sq_local_tail_ = 0; ///< Prepared but not yet published
+    unsigned sq_entries_ = 0;
+
+    // Completion ring
+    void* cq_ptr_ = nullptr;
+    std::size_t cq_len_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    // Provided buffer ring
+    io_uring_buf_ring* buf_ring_ = nullptr;
+    std::size_t buf_ring_len_ = 0;
+    char* buffers_ = nullptr;
+    std::size_t buffers_len_ = 0;
+    unsigned buffer_size_ = 0;
+    unsigned buf_mask_ = 0;
+    std::uint16_t buf_tail_ = 0;
+};
+
+template <typename Fn>
+unsigned IoUring::forEachCompletion(Fn&& fn)
+{
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    unsigned seen = 0;
+    for (; head != tail; ++head, ++seen)
+        fn(cqes_[head & cq_mask_]);
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return seen;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Receive buffer that frames a TCP byte stream into lines.
+ *
+ * recv() writes straight into the free tail (writable()/commit()), and
+ * complete lines are handed out as views into the same storage, so a
+ * line is never copied on its way to the command parser. A partial
+ * line stays buffered until a later read completes it; consumed bytes
+ * are reclaimed by sliding the remainder to the front only when the
+ * tail runs out of room.
+ *
+ * Not thread-safe: owned by one Connection and used only by the strand
+ * that currently runs its input.
+ */
+class LineBuffer
+{
+public:
+    /// @param max_line Longest line accepted; longer lines are dropped.
+    explicit LineBuffer(std::size_t max_line);
+
+    /**
+     * @brief Free space at the tail, growing or compacting as needed.
+     * @param min_space Bytes the caller wants to receive at once.
+     * @param avail     Set to the actual number of writable bytes.
+     */
+    char* writable(std::size_t min_space, std::size_t& avail);
+
+    /// @brief Mark @p n bytes written at writable() as received.
+    void commit(std::size_t n);
+
+    /**
+     * @brief Take the next complete line, without its "\n" or "\r\n".
+     *
+     * The view stays valid until the next writable() call.
+     * @return false if no complete line is buffered.
+     */
+    bool nextLine(std::string_view& line);
+
+    /// @brief true once per line dropped for exceeding max_line.
+    bool takeOverflow();
+
+    // ── Raw access (handshake and binary frames) ────────────────────
+
+    /// @brief All unconsumed bytes; valid until the next writable() call.
+    std::string_view peek() const;
+
+    /// @brief Drop the first @p n bytes returned by peek().
+    void consume(std::size_t n);
+
+private:
+    std::vector<char> buf_;
+    std::size_t head_ = 0;        ///< Start of unconsumed data
+    std::size_t tail_ = 0;        ///< End of received data
+    std::size_t scan_ = 0;        ///< Bytes before this are known to hold no '\n'
+    const std::size_t max_line_;
+    bool discarding_ = false;     ///< Dropping an oversized line up to its '\n'
+    bool overflow_ = false;
+};
\ No newline at end of file
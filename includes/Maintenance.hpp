@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Database.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Background upkeep of the database file.
+ *
+ * One thread that, every MAINTENANCE_INTERVAL_MS, checkpoints the WAL on
+ * its own connection (SQLite's checkpoint-on-commit is switched off while
+ * it runs, so the writer never pays for one) and hands a few free pages
+ * back to the filesystem. Once a checkpoint has caught up, and at most
+ * every WAL_TRUNCATE_INTERVAL_MS, it also truncates the WAL file. Every RETENTION_INTERVAL_MS it also prunes
+ * messages past the age or row limit, RETENTION_BATCH rows per
+ * transaction so the writer only ever waits for one small delete.
+ *
+ * With an archive directory, each batch is first appended to gzip
+ * segments named `messages-YYYY-MM-DD.tsv.gz` (UTC day of the message),
+ * one line per row: id, epoch ms, type, sender, receiver, content, with
+ * tab, newline, carriage return and backslash escaped. A batch whose
+ * archive write fails is kept and retried on the next pass. A crash
+ * between archiving and deleting can repeat rows; the ids tell them apart.
+ */
+class Maintenance
+{
+public:
+    /**
+     * @param retention_days Prune messages older than this (0 = no age limit).
+     * @param max_rows       Keep at most this many messages (0 = no cap).
+     * @param archive_dir    Where pruned rows are archived ("" = discard them).
+     */
+    Maintenance(Database& db, int retention_days, std::size_t max_rows, std::string archive_dir);
+    ~Maintenance();
+
+    Maintenance(const Maintenance&) = delete;
+    Maintenance& operator=(const Maintenance&) = delete;
+
+    /// @brief Start the thread (call once the database is open).
+    void start();
+
+    /// @brief Stop the thread and give checkpoints back to SQLite (idempotent).
+    void stop();
+
+private:
+    void run();
+
+    /// @brief Prune everything outside the policy. @return false if stopped midway.
+    bool prune();
+
+    /// @brief Append @p batch to its per-day segment files.
+    bool archive(const std::vector<ChatMessage>& batch);
+
+    Database& db_;
+    const std::int64_t max_age_ms_; ///< 0 = no age limit
+    const std::size_t max_rows_;    ///< 0 = no cap
+    const std::string archive_dir_; ///< "" = discard pruned rows
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
\ No newline at end of file
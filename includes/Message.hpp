@@ -1,15 +1,17 @@
-#pragma once
-
-#include <string>
-
-/**
- * @brief Represents one persisted chat message (DB row).
- */
-struct ChatMessage
-{
-    std::string sender;
-    std::string receiver;
-    std::string content;
-    std::string type;      ///< "private", "group", or "broadcast"
-    std::string timestamp; ///< "YYYY-MM-DD HH:MM:SS"
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Represents one persisted chat message (DB row).
+ */
+struct ChatMessage
+{
+    std::int64_t id = 0; ///< Row id, assigned in insertion order
+    std::string sender;
+    std::string receiver;
+    std::string content;
+    std::string type;              ///< "private", "group", or "broadcast"
+    std::int64_t timestamp_ms = 0; ///< Unix epoch milliseconds (UTC)
 };
\ No newline at end of file
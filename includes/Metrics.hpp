@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Process-wide counters and latency histograms.
+ *
+ * Every thread records into its own Shard, so the hot path is a
+ * thread-local lookup plus a plain load/store on a cache line no other
+ * thread writes — no lock and no contended atomic. Readers (/stats and
+ * the Prometheus endpoint) sum all shards on demand; shards of exited
+ * threads are kept so their counts are not lost.
+ *
+ * Histograms are log-linear (HDR-style): each power of two is split
+ * into 2^kSubBits buckets, which bounds the relative error of any
+ * reported quantile to about 6% over 1 ns … 68 s.
+ */
+namespace Metrics
+{
+    enum class Counter : std::uint8_t
+    {
+        ConnectionsAccepted,
+        ConnectionsClosed,
+        BytesIn,
+        BytesOut,
+        OverloadEvents,
+        ShedConnections,
+        ShedCommands,
+        DbRowsWritten,
+        DbRowsPruned,
+        AuthRejected, ///< /reg or /login refused: auth queue full
+        OfflineQueued,
+        OfflineDelivered,
+        Count
+    };
+
+    enum class Latency : std::uint8_t
+    {
+        Broadcast,
+        Private, ///< /to
+        Group,
+        History,
+        Login,
+        Register,
+        Create,
+        Join,
+        Quit,
+        Stats,
+        DbCommit, ///< One write-behind batch transaction
+        AuthWait, ///< Time a /reg or /login spent queued for the auth executor
+        AuthKdf,  ///< One password hash or verification
+        Count
+    };
+
+    constexpr std::size_t kCounters = static_cast<std::size_t>(Counter::Count);
+    constexpr std::size_t kLatencies = static_cast<std::size_t>(Latency::Count);
+
+    constexpr unsigned kSubBits = 4;
+    constexpr unsigned kMaxExponent = 35; ///< Values clamp at 2^36 ns (~68 s)
+    constexpr std::size_t kBuckets = (kMaxExponent - kSubBits + 2) << kSubBits;
+
+    /// @brief One thread's slice of every metric.
+    struct alignas(64) Shard
+    {
+        std::atomic<std::uint64_t> counters[kCounters];
+
+        struct Histogram
+        {
+            std::atomic<std::uint64_t> count;
+            std::atomic<std::uint64_t> sum_ns;
+            std::atomic<std::uint64_t> buckets[kBuckets];
+        } histograms[kLatencies];
+    };
+
+    /// @brief Allocate and register the calling thread's shard.
+    Shard& registerShard();
+
+    inline thread_local Shard* t_shard = nullptr;
+
+    inline Shard& localShard()
+    {
+        Shard* s = t_shard;
+        return s ? *s : registerShard();
+    }
+
+    /// @brief Single-writer increment: only the owning thread stores to @p a.
+    inline void bump(std::atomic<std::uint64_t>& a, std::uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /// @brief Histogram bucket holding @p ns.
+    inline std::size_t bucketFor(std::uint64_t ns)
+    {
+        constexpr std::uint64_t kLinear = 1u << kSubBits;
+        constexpr std::uint64_t kMax = (std::uint64_t{1} << (kMaxExponent + 1)) - 1;
+        if (ns < kLinear) return static_cast<std::size_t>(ns);
+        if (ns > kMax) ns = kMax;
+        unsigned e = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+        std::uint64_t sub = (ns >> (e - kSubBits)) & (kLinear - 1);
+        return static_cast<std::size_t>(((e - kSubBits + 1) << kSubBits) + sub);
+    }
+
+    /// @brief Largest value that lands in bucket @p i.
+    std::uint64_t bucketUpperBound(std::size_t i);
+
+    inline void add(Counter c, std::uint64_t n = 1)
+    {
+        bump(localShard().counters[static_cast<std::size_t>(c)], n);
+    }
+
+    inline void record(Latency l, std::uint64_t ns)
+    {
+        Shard::Histogram& h = localShard().histograms[static_cast<std::size_t>(l)];
+        bump(h.count, 1);
+        bump(h.sum_ns, ns);
+        bump(h.buckets[bucketFor(ns)], 1);
+    }
+
+    inline std::uint64_t nowNs()
+    {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+    /// @brief Records the time from construction to destruction into one histogram.
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Latency l) : latency_(l), start_(nowNs()) {}
+        ~ScopedTimer() { record(latency_, nowNs() - start_); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Latency latency_;
+        std::uint64_t start_;
+    };
+
+    /// @brief Point-in-time value supplied by the owner at render time.
+    struct Gauge
+    {
+        const char* name; ///< Suffix after "chatx_"
+        const char* help;
+        double value;
+        bool counter = false; ///< Only ever grows: exported as a counter
+    };
+
+    /// @brief Sum of @p c over every shard.
+    std::uint64_t total(Counter c);
+
+    /// @brief Human-readable summary with p50/p99/p999 per histogram (for /stats).
+    std::string renderText(const std::vector<Gauge>& gauges);
+
+    /// @brief Prometheus text exposition format (version 0.0.4).
+    std::string renderPrometheus(const std::vector<Gauge>& gauges);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Local Unix-socket endpoint that serves the metrics page.
+ *
+ * Answers each connection with whatever the render callback returns and
+ * closes it. Requests that start with "GET" get an HTTP/1.0 response
+ * (so `curl --unix-socket` and a Prometheus sidecar work); anything
+ * else, including an empty request from `nc -U`, gets the bare text.
+ *
+ * Runs on its own thread so a slow scraper never stalls a reactor, and
+ * drops a scraper that does not take the response within a second so
+ * it cannot hold up the next one or stop().
+ */
+class MetricsEndpoint
+{
+public:
+    using Render = std::function<std::string()>;
+
+    MetricsEndpoint(std::string path, Render render);
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint&) = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    /// @brief Bind the socket and start serving. @return false if the socket could not be bound.
+    bool start();
+
+    /// @brief Stop serving and remove the socket file.
+    void stop();
+
+private:
+    void run();
+    void serve(int fd);
+
+    /// @brief Write @p data before the deadline or stop(). @return false if the client was dropped.
+    bool sendBounded(int fd, const std::string& data);
+
+    std::string path_;
+    Render render_;
+    int listen_fd_ = -1;
+    int wake_fd_ = -1; ///< eventfd that interrupts poll() on stop()
+    std::thread thread_;
+};
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Optional length-prefixed binary wire format.
+ *
+ * A client opts in by making its very first bytes the 8-byte hello
+ * ("\0SCX", version, 3 reserved bytes); the server answers with an
+ * 8-byte ack of the same shape whose fifth byte is its version and
+ * whose sixth is a status (0 = accepted). Anything else as the first
+ * byte keeps the connection on the text protocol.
+ *
+ * After the handshake both directions exchange frames:
+ *
+ *     u32 length | u16 opcode | u16 flags | u32 request_id | payload[length]
+ *
+ * (big-endian). Request payloads are a command's argument text, so
+ * binary and text commands share their handlers; every reply to a
+ * request echoes its request_id, and messages pushed by other users
+ * arrive as Event frames with request_id 0.
+ */
+namespace Protocol
+{
+    constexpr char MAGIC[4] = {'\0', 'S', 'C', 'X'};
+    constexpr std::uint8_t VERSION = 1;
+    constexpr std::size_t HELLO_SIZE = 8;
+    constexpr std::size_t HEADER_SIZE = 12;
+
+    /// Per-connection wire format, fixed by the first bytes received.
+    enum class WireMode : std::uint8_t
+    {
+        Pending, ///< Nothing received yet (outbound traffic is text)
+        Text,
+        Binary
+    };
+
+    enum class Opcode : std::uint16_t
+    {
+        // client → server
+        Chat = 0x01,    ///< Broadcast payload to everyone
+        Reg = 0x02,     ///< "<user> <pass>"
+        Login = 0x03,   ///< "<user> <pass>"
+        To = 0x04,      ///< "<user> <msg>"
+        Create = 0x05,  ///< "<group>"
+        Join = 0x06,    ///< "<group>"
+        Group = 0x07,   ///< "<group> <msg>"
+        History = 0x08, ///< "[before <id>] [n]"
+        Quit = 0x09,
+        Pong = 0x0A,  ///< Answer to Ping (any frame counts as activity)
+        Stats = 0x0B, ///< Admin only: server metrics summary
+
+        // server → client
+        Reply = 0x81, ///< Response to the request with the same id
+        Event = 0x82, ///< Message pushed by someone else
+        Error = 0x83, ///< Request (or frame) rejected
+        Ping = 0x84   ///< Heartbeat; the client should answer (e.g. with Pong)
+    };
+
+    struct FrameHeader
+    {
+        std::uint32_t length;
+        Opcode opcode;
+        std::uint16_t flags;
+        std::uint32_t request_id;
+    };
+
+    /// @brief Outcome of inspecting the first bytes of a connection.
+    enum class Hello
+    {
+        NeedMore, ///< A prefix of the hello; wait for the rest
+        Text,     ///< Not a hello: plain text client
+        Accepted,
+        Rejected  ///< Hello with an unsupported version
+    };
+
+    /// @brief Classify the bytes received before any mode was chosen.
+    Hello parseHello(std::string_view data);
+
+    /// @brief The 8-byte answer to a hello (status 0 = accepted).
+    std::string makeAck(std::uint8_t status);
+
+    /// @brief Decode a header from HEADER_SIZE bytes at @p p.
+    FrameHeader decodeHeader(const char* p);
+
+    /**
+     * @brief Build a complete frame in one exactly-sized allocation.
+     *
+     * A trailing "\r\n" on @p payload is dropped: text replies end in
+     * one, but a frame already carries its own length.
+     */
+    std::shared_ptr<const std::string> encodeFrame(Opcode op, std::uint32_t request_id,
+                                                   std::string_view payload);
+}
\ No newline at end of file
@@ -1,63 +1,433 @@
-#pragma once
-
-#include "Database.hpp"
-#include "ThreadPool.hpp"
-#include "UserManager.hpp"
-
-#include <atomic>
-#include <string>
-#include <vector>
-
-/**
- * @brief TCP chat server using Linux epoll and a thread pool.
- *
- * Lifecycle: construct → run_server() (blocks until SIGINT/SIGTERM).
- */
-class Server
-{
-public:
-    Server();
-    ~Server();
-
-    Server(const Server&) = delete;
-    Server& operator=(const Server&) = delete;
-
-    /// @brief One-call entry point: bind, epoll, event loop.
-    void run_server();
-
-    /// @brief Global flag set by the signal handler for graceful shutdown.
-    static std::atomic<bool> quit;
-
-private:
-    Database db_;
-    UserManager userManager_;
-    ThreadPool threadPool_;
-
-    int listen_fd_ = -1;
-    int epoll_fd_ = -1;
-
-    // ── Setup ───────────────────────────────────────────────────────
-
-    void create_and_bind();
-    void setup_epoll();
-
-    // ── Event loop ──────────────────────────────────────────────────
-
-    void run_event_loop();
-    void handle_new_connection();
-    void handle_client_disconnection(int fd);
-    void handle_client_input(int fd);
-
-    // ── Messaging helpers ───────────────────────────────────────────
-
-    void broadcast_message(int from_fd, const std::string& msg);
-
-    /**
-     * @brief Format a filtered history block for the given user.
-     * @param nickname Viewer's username (for visibility filtering).
-     * @param fd       Viewer's fd (for group membership checks).
-     * @param limit    Number of messages to fetch.
-     * @return Ready-to-send string including the header.
-     */
-    std::string formatHistory(const std::string& nickname, int fd, int limit);
-};
+#pragma once
+
+#include "Config.hpp"
+#include "Connection.hpp"
+#include "Database.hpp"
+#include "IoUring.hpp"
+#include "Maintenance.hpp"
+#include "Metrics.hpp"
+#include "MetricsEndpoint.hpp"
+#include "Protocol.hpp"
+#include "Settings.hpp"
+#include "ThreadPool.hpp"
+#include "TimerWheel.hpp"
+#include "Tokenizer.hpp"
+#include "UserManager.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief TCP chat server using Linux epoll (or io_uring) and a thread pool.
+ *
+ * Runs either as a single reactor that hands input to the ThreadPool
+ * (Settings::reactor_threads == 0), or as N reactors that each own an
+ * SO_REUSEPORT listener and process their connections inline.
+ *
+ * Lifecycle: construct → run_server() (blocks until SIGINT/SIGTERM).
+ */
+class Server
+{
+public:
+    /// @param settings Runtime parameters; use_io_uring falls back to epoll when the kernel lacks it.
+    explicit Server(const Settings& settings = Settings());
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /// @brief One-call entry point: bind, epoll, event loop.
+    void run_server();
+
+    /// @brief Global flag set by the signal handler for graceful shutdown.
+    static std::atomic<bool> quit;
+
+    /**
+     * @brief Render one /history page (header, "#id" rows, paging hint).
+     * @param messages Visible messages, newest first.
+     * @param limit    Requested page size (a full page gets an "older" hint).
+     */
+    static std::string renderHistory(const std::vector<ChatMessage>& messages, int limit);
+
+private:
+    /**
+     * @brief One event loop: its listener, epoll instance and mailbox.
+     *
+     * Other threads hand work to a reactor by pushing onto its mailbox
+     * and writing to its eventfd; the loop drains the mailbox on wakeup.
+     */
+    struct Reactor
+    {
+        int id = 0;
+        int listen_fd = -1;
+        int epoll_fd = -1;
+        int wake_fd = -1; ///< eventfd used to interrupt epoll_wait
+
+        std::mutex mailbox_mtx;
+        std::vector<std::function<void()>> mailbox; ///< Tasks posted by other threads
+        std::vector<Task> dispatch_batch;           ///< Pool work gathered in one epoll pass
+        std::vector<std::shared_ptr<Connection>> paused; ///< Reads held back while overloaded
+        TimerWheel timers{Config::TIMER_WHEEL_SLOTS, Config::TIMER_TICK_MS}; ///< Idle/heartbeat deadlines
+        std::vector<std::shared_ptr<Connection>> due;    ///< Scratch list for run_timers()
+        std::thread thread;
+
+        // io_uring backend only
+        std::unique_ptr<IoUring> ring;
+        /// Connections with operations in the ring; keeps each alive until its last completion.
+        std::unordered_map<Connection*, std::shared_ptr<Connection>> uring_conns;
+        std::vector<std::shared_ptr<Connection>> send_ready; ///< Output to submit on the next pass
+        std::vector<std::shared_ptr<Connection>> recv_rearm; ///< Multishot recvs that ended
+    };
+
+    const Settings settings_;
+
+    Database db_;
+    Maintenance maintenance_; ///< Retention, archival and WAL checkpoints for db_
+    UserManager userManager_;
+    ThreadPool threadPool_;
+
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    bool inline_dispatch_; ///< true in N-reactor mode (no ThreadPool hop)
+    bool use_uring_;       ///< Reactors run run_uring_loop() instead of epoll
+
+    // ── Overload state (pool mode) ──────────────────────────────────
+
+    std::atomic<bool> overloaded_{false}; ///< Pool backlog passed the high-water mark
+
+    mutable std::shared_mutex conn_mtx_;                               ///< Protects connections_
+    std::unordered_map<int, std::shared_ptr<Connection>> connections_; ///< fd → connection
+
+    MetricsEndpoint metrics_endpoint_; ///< Prometheus text on Settings::metrics_socket_path
+
+    /// Runs the password KDF off the reactors and workers. Declared last so
+    /// it drains before anything its tasks touch is destroyed.
+    ThreadPool authPool_;
+
+    // ── Setup ───────────────────────────────────────────────────────
+
+    /// @brief Listening socket for @p r; client sockets inherit its buffer sizes.
+    void create_and_bind(Reactor& r, bool reuse_port);
+    void setup_epoll(Reactor& r);
+
+    /// @brief Create @p r's ring and buffer ring, then arm accept and wakeup. @return false if unsupported.
+    bool setup_uring(Reactor& r);
+
+    // ── Event loop ──────────────────────────────────────────────────
+
+    void run_event_loop(Reactor& r);
+    void handle_new_connection(Reactor& r);
+
+    /// @brief Admit an accepted socket: shed check, session, I/O registration, timer, welcome.
+    void register_client(Reactor& r, int cfd);
+
+    void handle_client_disconnection(int fd);
+
+    /// @brief Dispatch the pass's batch, then resume paused reads and fire timers.
+    void finish_pass(Reactor& r);
+
+    /// @brief Read @p conn's socket into its LineBuffer and run every complete line or frame.
+    void handle_client_input(Connection& conn);
+
+    /// @brief Frame whatever in_buf holds. @return false once the connection is closed.
+    bool consume_input(Connection& conn);
+
+    /// @brief Pick the wire mode from the first bytes received. @return false if the connection was closed.
+    bool negotiate(Connection& conn);
+
+    void process_lines(Connection& conn);
+    void process_frames(Connection& conn);
+
+    /// @brief Tear down @p conn unless its fd already belongs to a newer connection.
+    void close_connection(const std::shared_ptr<Connection>& conn);
+
+    // ── io_uring backend ────────────────────────────────────────────
+
+    /**
+     * @brief Completion-driven event loop.
+     *
+     * Each pass submits the output queued since the last one, re-arms
+     * ended recvs, then waits in a single io_uring_enter for completions.
+     * Received bytes land in provided buffers and are copied to the
+     * connection's rx_pending; strands frame them exactly as with epoll.
+     */
+    void run_uring_loop(Reactor& r);
+
+    void handle_completion(Reactor& r, const io_uring_cqe& cqe);
+    void on_uring_recv(Reactor& r, const std::shared_ptr<Connection>& conn, const io_uring_cqe& cqe);
+    void on_uring_send(Reactor& r, const std::shared_ptr<Connection>& conn, const io_uring_cqe& cqe);
+
+    /// @brief Submit one SENDMSG per connection on @p r's send list, and re-arm recvs.
+    void submit_sends(Reactor& r);
+
+    void arm_recv(Reactor& r, Connection& conn);
+
+    /// @brief Have @p conn's owner submit its queued output. Caller holds io_mtx.
+    void schedule_send(Connection& conn);
+
+    /// @brief Close and forget a closed connection once neither the ring nor a strand holds it. Caller holds io_mtx.
+    void reap(Reactor& r, const std::shared_ptr<Connection>& conn);
+
+    // ── Command dispatch ────────────────────────────────────────────
+
+    /// @brief One parsed request (text line or binary frame) as seen by a handler.
+    struct CommandContext
+    {
+        int fd;
+        std::string nickname;     ///< Empty unless the client is logged in
+        Tokenizer args;           ///< Positioned at the command's arguments
+        std::uint32_t request_id; ///< Echoed in binary replies
+        bool binary;              ///< Replies go out as Reply frames
+    };
+
+    using CommandHandler = void (Server::*)(CommandContext&);
+
+    /// @brief Entry in the command table.
+    struct CommandSpec
+    {
+        std::string_view name;   ///< Command token including the leading '/'
+        Protocol::Opcode opcode; ///< Same command in the binary protocol
+        CommandHandler handler;
+        bool requires_auth;    ///< Reject with a login prompt when not logged in
+        bool low_priority;     ///< Refused while the server is overloaded
+        Metrics::Latency latency; ///< Histogram the handler's run time goes to
+    };
+
+    static const CommandSpec kCommands[];
+
+    /// @brief Table entry for @p name, or nullptr for unknown commands.
+    static const CommandSpec* find_command(std::string_view name);
+    static const CommandSpec* find_command(Protocol::Opcode opcode);
+
+    /**
+     * @brief Run one input line.
+     *
+     * Lines starting with '/' are looked up in kCommands; anything else
+     * (including unknown commands) is broadcast once logged in.
+     */
+    void dispatch_line(int fd, std::string_view line);
+
+    /// @brief Run one binary frame; its payload is the command's argument text.
+    void dispatch_frame(int fd, const Protocol::FrameHeader& h, std::string_view payload);
+
+    /// @brief Auth-check and run @p cmd, or broadcast @p text when @p cmd is null.
+    void run_command(const CommandSpec* cmd, CommandContext& ctx, std::string_view text);
+
+    /**
+     * @brief Answer the client that sent @p ctx in its own wire format.
+     * @param on_queued Run on the owning reactor once @p msg is queued.
+     * @return As deliver().
+     */
+    bool reply(const CommandContext& ctx, std::string_view msg,
+               std::function<void()> on_queued = nullptr);
+
+    void cmd_quit(CommandContext& ctx);
+    void cmd_reg(CommandContext& ctx);
+    void cmd_login(CommandContext& ctx);
+
+    /**
+     * @brief Reply to a finished /login (success also sends recent history).
+     *
+     * A success reads SQLite, so it only runs on the auth executor.
+     */
+    void finish_login(const CommandContext& ctx, const std::string& name, bool ok);
+    void cmd_history(CommandContext& ctx);
+    void cmd_to(CommandContext& ctx);
+    void cmd_create(CommandContext& ctx);
+    void cmd_join(CommandContext& ctx);
+    void cmd_group(CommandContext& ctx);
+    void cmd_stats(CommandContext& ctx);
+
+    // ── Per-connection strands ──────────────────────────────────────
+
+    /**
+     * @brief React to epoll readiness on a client socket.
+     *
+     * Flushes output, or hands input to run_strand() unless one is
+     * already running for this connection. In pool mode the strand is
+     * queued on @p r's dispatch batch, and client fds are registered
+     * with EPOLLONESHOT, so at most one worker touches a socket at a
+     * time and commands from one client stay in order.
+     */
+    void handle_client_event(Reactor& r, int fd, uint32_t ev);
+
+    /// @brief Run the input handler, then clear in_flight and re-arm (or finish a deferred close).
+    void run_strand(const std::shared_ptr<Connection>& conn);
+
+    // ── Auth executor ───────────────────────────────────────────────
+
+    /// @brief A /reg or /login handed to the auth executor.
+    struct AuthRequest
+    {
+        std::shared_ptr<Connection> conn;
+        std::string username;
+        std::string password;
+        std::uint32_t request_id;
+        bool binary;
+        bool registering;        ///< /reg rather than /login
+        bool verified;           ///< Login already accepted by the credential cache: replay only
+        std::uint64_t queued_ns; ///< Metrics::nowNs() at submission
+    };
+
+    /**
+     * @brief Queue a credential check that needs the KDF.
+     *
+     * The calling strand keeps running, but input after this command is
+     * held back (process_lines/process_frames stop at auth_pending) and
+     * the strand parks with in_flight set, so commands stay in order and
+     * the fd cannot be recycled under the task. Refused with "Server
+     * busy" once Config::AUTH_QUEUE_MAX requests are waiting.
+     *
+     * With @p verified the credential cache has already logged the user
+     * in; the task only runs finish_login()'s database reads, off the
+     * reactor, and is never refused.
+     */
+    void start_auth(const CommandContext& ctx, bool registering, std::string username,
+                    std::string password, bool verified = false);
+
+    /// @brief Body of one auth task: hash or verify, reply, then resume the strand.
+    void run_auth(AuthRequest& req);
+
+    /// @brief Clear auth_pending and restart @p conn's strand if it parked.
+    void resume_after_auth(const std::shared_ptr<Connection>& conn);
+
+    // ── Backpressure ────────────────────────────────────────────────
+
+    /**
+     * @brief Enter the overloaded state once the pool backlog reaches
+     *        Config::TASK_QUEUE_HIGH_WATER.
+     *
+     * While overloaded the reactor stops dispatching input (ready
+     * connections are parked with EPOLLIN disarmed), new connections and
+     * low-priority commands are shed, and output keeps flowing. The
+     * worker that sees the backlog fall to TASK_QUEUE_LOW_WATER clears
+     * the state and asks the reactor to resume_reads(). The backlog is
+     * therefore bounded by the high-water mark plus one epoll batch.
+     */
+    void check_overload();
+
+    /// @brief Re-arm every connection parked on @p r while overloaded.
+    void resume_reads(Reactor& r);
+
+    // ── Liveness ────────────────────────────────────────────────────
+
+    /**
+     * @brief Fire every expired deadline on @p r's timer wheel.
+     *
+     * Each connection carries one deadline. When it fires, the reactor
+     * compares it with the connection's last activity: a connection that
+     * has spoken since is simply rescheduled, so traffic never touches
+     * the wheel.
+     */
+    void run_timers(Reactor& r);
+
+    /**
+     * @brief Apply the idle/heartbeat policy to one connection whose deadline passed.
+     *
+     * Binary clients (with heartbeats enabled) get a Ping after
+     * Config::HEARTBEAT_INTERVAL_MS of silence and are closed if nothing
+     * arrives within Config::HEARTBEAT_TIMEOUT_MS. Everyone else is
+     * closed after Config::IDLE_TIMEOUT_MS of silence, if set.
+     */
+    void check_liveness(Reactor& r, const std::shared_ptr<Connection>& conn, std::int64_t now);
+
+    // ── Outbound queues ─────────────────────────────────────────────
+
+    /**
+     * @brief Write @p msg now if the socket takes it, queue the rest.
+     *
+     * Arms EPOLLOUT when anything is left over so the owning reactor
+     * flushes it later; the caller never waits on a slow reader. With
+     * io_uring nothing is written here: the owner submits the queue as
+     * one SENDMSG on its next pass.
+     * @return false on a hard socket error or when the queue would
+     *         exceed Config::MAX_OUTBOUND_BYTES.
+     */
+    bool queue_output(Connection& conn, const OutBuffer& buf);
+
+    /// @brief Flush queued output with writev(). Caller holds io_mtx. @return false on socket error.
+    bool flush_output(Connection& conn);
+
+    /// @brief Drop @p written bytes from the front of @p conn's queue. Caller holds io_mtx.
+    void consume_output(Connection& conn, std::size_t written);
+
+    /// @brief Epoll events @p conn should be armed for given its strand and output state.
+    uint32_t interest_mask(const Connection& conn) const;
+
+    /// @brief Re-register @p conn's epoll interest if it changed. Caller holds io_mtx.
+    void update_interest(Connection& conn);
+
+    // ── Cross-reactor delivery ──────────────────────────────────────
+
+    /// @brief Queue @p task on @p r and wake its loop if it was idle.
+    void post(Reactor& r, std::function<void()> task);
+
+    /// @brief Run every task currently in @p r's mailbox.
+    void drain_mailbox(Reactor& r);
+
+    std::shared_ptr<Connection> find_connection(int fd) const;
+
+    /**
+     * @brief Send @p msg to @p fd from any thread.
+     *
+     * Queues directly when the caller is the owning reactor (or in
+     * single-reactor mode); otherwise hands the write to the owner's
+     * mailbox. Binary-mode clients receive @p msg as an Event frame.
+     * @return false if the fd is unknown or queue_output() failed.
+     */
+    bool send_to(int fd, const std::string& msg);
+
+    /// @brief Send one binary frame to @p fd (e.g. a Reply or Error).
+    bool send_frame(int fd, Protocol::Opcode op, std::uint32_t request_id,
+                    std::string_view payload);
+
+    /**
+     * @brief Queue an already encoded buffer on @p conn from any thread.
+     *
+     * @p on_queued runs right after a successful queue_output() and never
+     * after a failed one (the connection is closed instead).
+     * @return Whether queue_output() succeeded, or true once handed to
+     *         another reactor's mailbox.
+     */
+    bool deliver(const std::shared_ptr<Connection>& conn, const OutBuffer& buf,
+                 std::function<void()> on_queued = nullptr);
+
+    /**
+     * @brief Deliver one shared buffer to many connections.
+     *
+     * The payload is never copied: each recipient's queue holds a
+     * reference, and recipients owned by another reactor are handed
+     * over in a single mailbox task per reactor.
+     */
+    void fan_out(std::vector<std::shared_ptr<Connection>> targets, const OutBuffer& buf);
+
+    /// @brief Resolve @p fds to live connections under a single lock.
+    std::vector<std::shared_ptr<Connection>> collect_connections(const std::vector<int>& fds) const;
+
+    // ── Metrics ─────────────────────────────────────────────────────
+
+    /// @brief Current gauge values (connections, queue depth, ...) for a metrics page.
+    std::vector<Metrics::Gauge> gauges() const;
+
+    // ── Messaging helpers ───────────────────────────────────────────
+
+    void broadcast_message(int from_fd, const std::string& msg);
+
+    /**
+     * @brief Format one page of the history visible to the given user.
+     * @param nickname  Viewer's username (for visibility and group membership).
+     * @param limit     Number of visible messages to show.
+     * @param before_id Page cursor: only show ids below it (0 = newest).
+     * @return Ready-to-send string including the header.
+     */
+    std::string formatHistory(const std::string& nickname, int limit,
+                              std::int64_t before_id = 0);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Config.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Server parameters that can be tuned per host without a rebuild.
+ *
+ * Every field starts from its Config.hpp default. A config file of
+ * `key = value` lines (`#` starts a comment) overrides those, and
+ * `--key=value` flags override the file. Keys and flags share names:
+ *
+ *     port, backlog, workers, reactors, auth_threads, io, epoll_events,
+ *     recv_buffer, so_rcvbuf, so_sndbuf, reactor_cpus, worker_cpus,
+ *     db, retention_days, retention_rows, archive_dir, metrics_socket
+ *
+ * CPU lists take ranges, e.g. `0-3,8`.
+ */
+struct Settings
+{
+    int port = Config::SERVER_PORT;
+    int listen_backlog = Config::LISTEN_BACKLOG;
+    std::size_t worker_threads = Config::THREAD_POOL_SIZE; ///< 0 = one per core
+    std::size_t reactor_threads = Config::REACTOR_THREADS; ///< 0 = single reactor + workers
+    std::size_t auth_threads = Config::AUTH_THREADS;
+    bool use_io_uring = Config::USE_IO_URING;
+    int max_epoll_events = Config::MAX_EPOLL_EVENTS;
+    int recv_buffer_size = Config::RECV_BUFFER_SIZE;
+    int socket_rcvbuf = 0; ///< SO_RCVBUF for client sockets (0 = kernel default)
+    int socket_sndbuf = 0; ///< SO_SNDBUF for client sockets (0 = kernel default)
+    std::vector<int> reactor_cpus; ///< Reactor i runs on reactor_cpus[i % size] (empty = unpinned)
+    std::vector<int> worker_cpus;  ///< Same for pool workers
+    std::string db_filename = Config::DB_FILENAME;
+    int retention_days = Config::RETENTION_DAYS;            ///< 0 = keep messages forever
+    std::size_t retention_rows = Config::RETENTION_MAX_ROWS; ///< 0 = no cap
+    std::string archive_dir = Config::ARCHIVE_DIR;           ///< "" = discard pruned messages
+    std::string metrics_socket_path = Config::METRICS_SOCKET_PATH; ///< "" = off
+
+    /**
+     * @brief Apply one setting.
+     * @param[out] err Why @p key or @p value was rejected.
+     */
+    bool set(std::string_view key, std::string_view value, std::string& err);
+
+    /// @brief Apply every `key = value` line of @p path. @return false on I/O or parse errors.
+    bool loadFile(const std::string& path, std::string& err);
+
+    /**
+     * @brief Apply `--config=<file>` first, then every other `--key=value` flag.
+     * @param[out] help Set when `--help` was given.
+     */
+    bool parseArgs(int argc, char** argv, bool& help, std::string& err);
+
+    /// @brief worker_threads with 0 resolved to the core count.
+    std::size_t workerThreads() const;
+
+    /// @brief Text listing the flags, for --help and usage errors.
+    static std::string usage(const char* argv0);
+};
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Move-only `void()` callable with small-buffer storage.
+ *
+ * Replaces std::function for pool work items: captures up to
+ * kInlineSize bytes (e.g. `[this, conn]`) live inside the Task itself,
+ * so submitting one does not touch the heap, and move-only captures
+ * are allowed. Larger callables fall back to a single heap allocation.
+ */
+class Task
+{
+public:
+    static constexpr std::size_t kInlineSize = 48;
+
+    Task() noexcept = default;
+
+    /// Implicit, so call sites can hand a lambda straight to the pool.
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& f)
+    {
+        using Fn = std::decay_t<F>;
+        if constexpr (fitsInline<Fn>())
+        {
+            ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+            ops_ = &inlineOps<Fn>;
+        }
+        else
+        {
+            ::new (static_cast<void*>(storage_)) Fn*(new Fn(std::forward<F>(f)));
+            ops_ = &heapOps<Fn>;
+        }
+    }
+
+    Task(Task&& other) noexcept { take(other); }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void operator()() { ops_->invoke(storage_); }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void* self);
+        void (*move)(void* dst, void* src) noexcept; ///< Move-construct into dst, destroy src
+        void (*destroy)(void* self) noexcept;
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Fn>;
+    }
+
+    template <typename Fn>
+    static constexpr Ops inlineOps = {
+        [](void* self) { (*static_cast<Fn*>(self))(); },
+        [](void* dst, void* src) noexcept
+        {
+            ::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* self) noexcept { static_cast<Fn*>(self)->~Fn(); }};
+
+    template <typename Fn>
+    static constexpr Ops heapOps = {
+        [](void* self) { (**static_cast<Fn**>(self))(); },
+        [](void* dst, void* src) noexcept { ::new (dst) Fn*(*static_cast<Fn**>(src)); },
+        [](void* self) noexcept { delete *static_cast<Fn**>(self); }};
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_ = nullptr;
+
+    void take(Task& other) noexcept
+    {
+        if (!other.ops_) return;
+        other.ops_->move(storage_, other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+    }
+
+    void reset() noexcept
+    {
+        if (!ops_) return;
+        ops_->destroy(storage_);
+        ops_ = nullptr;
+    }
+};
\ No newline at end of file
@@ -1,47 +1,99 @@
-#pragma once
-
-#include <condition_variable>
-#include <functional>
-#include <mutex>
-#include <queue>
-#include <thread>
-#include <vector>
-
-/**
- * @brief A simple thread pool that dispatches std::function<void()> tasks.
- *
- * Workers block on a condition variable until a task is available or
- * the pool is shut down.
- */
-class ThreadPool
-{
-public:
-    /**
-     * @brief Construct and launch @p num_threads worker threads.
-     * @param num_threads Number of threads in the pool.
-     */
-    explicit ThreadPool(std::size_t num_threads);
-
-    /// @brief Signal stop, drain the queue, and join all workers.
-    ~ThreadPool();
-
-    ThreadPool(const ThreadPool&) = delete;
-    ThreadPool& operator=(const ThreadPool&) = delete;
-
-    /**
-     * @brief Submit a task for asynchronous execution.
-     * @param task Callable to run on a worker thread.
-     * @throws std::runtime_error if the pool has been stopped.
-     */
-    void enqueue(std::function<void()> task);
-
-private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex mtx;
-    std::condition_variable cv;
-    bool stop;
-
-    /// @brief Worker loop: dequeue and execute tasks until stopped.
-    void worker_thread();
+#pragma once
+
+#include "Task.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Work-stealing thread pool for move-only Tasks.
+ *
+ * Each worker owns a deque with its own lock. Tasks submitted from a
+ * worker go to that worker's deque; tasks from outside (the reactor)
+ * are spread round-robin. A worker that runs dry steals half of a
+ * peer's deque (from the back) before going to sleep, so no single lock is
+ * shared by every submit and every dequeue.
+ *
+ * Sleeping workers are only signalled when none is already searching
+ * for work, and enqueue_batch() issues one round of wakeups for a whole
+ * batch, capped at the core count; a searcher that finds work with
+ * more queued behind it wakes the next one.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Construct and launch @p num_threads worker threads.
+     * @param num_threads Number of threads in the pool.
+     * @param pin_cpus    Worker i is pinned to pin_cpus[i % size] (empty = unpinned).
+     */
+    explicit ThreadPool(std::size_t num_threads, std::vector<int> pin_cpus = {});
+
+    /// @brief Signal stop, drain the queues, and join all workers.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Submit a task for asynchronous execution.
+     * @param task Callable to run on a worker thread.
+     * @throws std::runtime_error if the pool has been stopped or has no workers.
+     */
+    void enqueue(Task task);
+
+    /**
+     * @brief Submit every task in @p tasks, then wake workers once.
+     *
+     * @p tasks is left empty (with its capacity kept for reuse).
+     * @throws std::runtime_error if the pool has been stopped or has no workers.
+     */
+    void enqueue_batch(std::vector<Task>& tasks);
+
+    std::size_t size() const { return workers.size(); }
+
+    /// @brief Tasks submitted but not yet picked up by a worker.
+    std::size_t depth() const { return queued.load(std::memory_order_relaxed); }
+
+private:
+    /// One worker's queue, on its own cache line.
+    struct alignas(64) Queue
+    {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<std::size_t> next_queue{0}; ///< Round-robin cursor for outside submitters
+
+    std::atomic<std::size_t> queued{0}; ///< Tasks pushed but not yet taken
+    std::atomic<std::size_t> idle{0};   ///< Workers blocked (or about to block) on cv
+    std::atomic<std::size_t> searching{0}; ///< Workers currently scanning peers for work
+    const std::size_t max_wake;            ///< Most workers one submit wakes (core count)
+    const std::vector<int> cpus;           ///< CPUs workers are pinned to (empty = unpinned)
+    std::mutex sleep_mtx;
+    std::condition_variable cv;
+    std::atomic<bool> stop{false};
+
+    /// @brief Queue a task should go to: the caller's own, or the next in turn.
+    Queue& pick_queue();
+
+    /// @brief Wake up to @p n sleeping workers.
+    void wake(std::size_t n);
+
+    /// @brief Pop the oldest task from our own queue.
+    bool pop_own(std::size_t self, Task& out);
+
+    /// @brief Take the newer half of some peer's queue (one task into @p out, the rest into ours).
+    bool steal(std::size_t self, Task& out);
+
+    /// @brief Worker loop: run tasks until stopped and drained.
+    void worker_thread(std::size_t index);
 };
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Connection;
+
+/**
+ * @brief Hashed timing wheel of per-connection deadlines.
+ *
+ * Deadlines hash into `slots` buckets of `tick_ms` each, so schedule()
+ * is O(1) and advance() only touches the buckets whose tick has passed.
+ * A deadline further out than one revolution simply stays in its bucket
+ * until a later pass finds it due.
+ *
+ * There is no cancel: rescheduling records the new deadline on the
+ * connection, and entries that no longer match it (or whose connection
+ * is gone) are dropped when their bucket comes up. Activity therefore
+ * costs nothing here; the owner re-checks it when a deadline fires.
+ *
+ * Not thread-safe: each reactor owns one and uses it from its loop.
+ */
+class TimerWheel
+{
+public:
+    TimerWheel(std::size_t slots, std::int64_t tick_ms);
+
+    /// @brief Fire @p conn at @p deadline_ms, replacing its previous deadline.
+    void schedule(const std::shared_ptr<Connection>& conn, std::int64_t deadline_ms);
+
+    /// @brief Collect connections whose current deadline is at or before @p now_ms.
+    void advance(std::int64_t now_ms, std::vector<std::shared_ptr<Connection>>& due);
+
+    /// @brief Milliseconds until the next bucket with entries is due, capped at @p cap_ms.
+    int waitMs(std::int64_t now_ms, int cap_ms) const;
+
+    std::size_t size() const { return size_; }
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<Connection> conn;
+        std::int64_t deadline_ms;
+    };
+
+    std::vector<std::vector<Entry>> slots_;
+    const std::int64_t tick_ms_;
+    std::int64_t current_tick_ = -1; ///< Last tick advance() has processed
+    std::size_t size_ = 0;
+};
\ No newline at end of file
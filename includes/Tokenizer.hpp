@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Splits a command line into whitespace-separated tokens in place.
+ *
+ * Every token is a view into the original line, so parsing a command
+ * allocates nothing; the line must outlive the tokenizer.
+ */
+class Tokenizer
+{
+public:
+    explicit Tokenizer(std::string_view text);
+
+    /// @brief Next token, or an empty view when none is left.
+    std::string_view next();
+
+    /// @brief Everything after the current token, leading whitespace skipped.
+    std::string_view rest();
+
+    /// @brief true once only whitespace remains.
+    bool done();
+
+private:
+    std::string_view text_;
+    std::size_t pos_ = 0;
+
+    void skipSpace();
+};
\ No newline at end of file
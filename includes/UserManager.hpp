@@ -1,66 +1,216 @@
-#pragma once
-
-#include "ClientSession.hpp"
-#include "Database.hpp"
-
-#include <shared_mutex>
-#include <string>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-
-class UserManager
-{
-public:
-    /**
-     * @brief Construct with a reference to the shared database.
-     * @param db Database used to persist / look-up user credentials.
-     */
-    explicit UserManager(Database& db);
-    ~UserManager() = default;
-
-    // ── Auth ────────────────────────────────────────────────────────
-
-    /// @brief Register a new user (persisted to DB) and auto-login.
-    bool registerUser(int fd, const std::string& username, const std::string& password);
-
-    /// @brief Log in with existing credentials.
-    bool loginUser(int fd, const std::string& username, const std::string& password);
-
-    /// @brief Check if fd is authenticated.
-    bool isLoggedIn(int fd) const;
-
-    /// @brief Return the nickname bound to @p fd (empty if none).
-    std::string getNickname(int fd) const;
-
-    /// @brief Log the user out (clear session state but keep the connection).
-    void logoutUser(int fd);
-
-    // ── Session tracking ────────────────────────────────────────────
-
-    void addClient(int fd);
-    void removeClient(int fd);
-    bool hasClient(int fd) const;
-
-    /// @brief Get a snapshot of all currently connected fds.
-    std::vector<int> getAllFds() const;
-
-    ClientSession getSession(int fd) const;
-    int getFdByNickname(const std::string& nickname) const;
-
-    // ── Groups ──────────────────────────────────────────────────────
-
-    bool createGroup(const std::string& groupname);
-    bool joinGroup(const std::string& groupname, int fd);
-    bool isInGroup(const std::string& groupname, int fd) const;
-    std::unordered_set<int> getGroupMembers(const std::string& groupname) const;
-
-private:
-    Database& db_; ///< Shared database reference
-
-    mutable std::shared_mutex mtx_; ///< Read-write lock for all containers below
-
-    std::unordered_map<int, ClientSession> clients_;                  ///< fd → session
-    std::unordered_map<std::string, int> nickname_map_;               ///< online nickname → fd
-    std::unordered_map<std::string, std::unordered_set<int>> groups_; ///< group → member fds
+#pragma once
+
+#include "ClientSession.hpp"
+#include "Config.hpp"
+#include "CredentialCache.hpp"
+#include "Database.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Session, nickname and group bookkeeping shared by all threads.
+ *
+ * Sessions live in a dense table indexed by fd and guarded by striped
+ * read-write locks, so per-command lookups touch one slot and contend
+ * only with operations on fds in the same stripe. Nicknames are striped
+ * by hash the same way; groups keep their own lock.
+ *
+ * Groups and memberships are persisted by username and loaded back by
+ * loadGroups(), so they survive restarts and reconnects. In memory,
+ * users and groups are numbered densely: each group lists its member
+ * ids, each member records its groups and its fd while online, and a
+ * per-group snapshot of online fds is patched on join, login and logout.
+ */
+class UserManager
+{
+public:
+    /**
+     * @brief Construct with a reference to the shared database.
+     * @param db      Database used to persist / look-up user credentials.
+     * @param max_fds Size of the fd-indexed table (0 = RLIMIT_NOFILE).
+     * @param kdf_iterations PBKDF2 cost for new and upgraded password hashes.
+     */
+    explicit UserManager(Database& db, std::size_t max_fds = 0,
+                         std::uint32_t kdf_iterations = Config::PASSWORD_KDF_ITERATIONS);
+    ~UserManager();
+
+    UserManager(const UserManager&) = delete;
+    UserManager& operator=(const UserManager&) = delete;
+
+    // ── Auth ────────────────────────────────────────────────────────
+
+    /**
+     * @brief Register a new user (persisted to DB) and auto-login.
+     * @note Runs the password KDF: call from the auth executor, not a reactor.
+     */
+    bool registerUser(int fd, const std::string& username, const std::string& password);
+
+    /**
+     * @brief Log in with existing credentials.
+     * @note Runs the password KDF (and may rehash): call from the auth executor.
+     */
+    bool loginUser(int fd, const std::string& username, const std::string& password);
+
+    /**
+     * @brief Log in without the KDF if these credentials were verified recently.
+     * @param[out] ok Result of the login when the cache answered.
+     * @return false on a cache miss: fall back to loginUser().
+     */
+    bool loginCached(int fd, const std::string& username, const std::string& password, bool& ok);
+
+    /// @brief Check whether an account exists (cheap: no KDF).
+    bool userExists(const std::string& username) const { return db_.userExists(username); }
+
+    const CredentialCache& credentialCache() const { return credentials_; }
+
+    /// @brief Check if fd is authenticated.
+    bool isLoggedIn(int fd) const;
+
+    /// @brief Return the nickname bound to @p fd (empty if none).
+    std::string getNickname(int fd) const;
+
+    /**
+     * @brief isLoggedIn() and getNickname() in a single slot access.
+     * @param[out] nickname Receives the nickname if authenticated.
+     * @return true if @p fd is authenticated.
+     */
+    bool getAuthorizedNickname(int fd, std::string& nickname) const;
+
+    /// @brief Log the user out (clear session state but keep the connection).
+    void logoutUser(int fd);
+
+    // ── Session tracking ────────────────────────────────────────────
+
+    /// @brief Start tracking @p fd. @return false if fd exceeds the table.
+    bool addClient(int fd);
+    void removeClient(int fd);
+    bool hasClient(int fd) const;
+
+    /// @brief Get a snapshot of all currently connected fds.
+    std::vector<int> getAllFds() const;
+
+    ClientSession getSession(int fd) const;
+    int getFdByNickname(const std::string& nickname) const;
+
+    // ── Groups ──────────────────────────────────────────────────────
+
+    /// @brief Build the membership index from the DB. @return Groups loaded.
+    std::size_t loadGroups();
+
+    /// @brief Persist a new group. @return false if the name is taken.
+    bool createGroup(const std::string& groupname);
+
+    /// @brief Persist @p fd's user as a member. @return false if unknown group or already a member.
+    bool joinGroup(const std::string& groupname, int fd);
+
+    bool isInGroup(const std::string& groupname, const std::string& username) const;
+
+    /// @brief Names of every group @p username has joined.
+    std::vector<std::string> getGroupsOf(const std::string& username) const;
+
+    /**
+     * @brief Immutable snapshot of the fds of a group's online members.
+     *
+     * Patched whenever a member joins, logs in or leaves, so each message
+     * only bumps a reference count instead of walking the member list.
+     * Never null.
+     */
+    std::shared_ptr<const std::vector<int>> getGroupMembers(const std::string& groupname) const;
+
+private:
+    static constexpr std::size_t kStripes = 64;    ///< Lock stripes (power of two)
+    static constexpr std::size_t kChunkSize = 1024; ///< Slots allocated together
+
+    static constexpr std::uint8_t kActive = 1;     ///< Slot holds a connected client
+    static constexpr std::uint8_t kAuthorized = 2; ///< ...who has logged in
+
+    /**
+     * @brief One fd's entry in the session table.
+     *
+     * @c flags mirrors the session state and is only written under the
+     * stripe lock, so hasClient() / isLoggedIn() can read it lock-free.
+     */
+    struct Slot
+    {
+        std::atomic<std::uint8_t> flags{0};
+        ClientSession session;
+    };
+
+    /// A lock on its own cache line so neighbouring stripes don't false-share.
+    struct alignas(64) Stripe
+    {
+        mutable std::shared_mutex mtx;
+    };
+
+    /// One shard of the online nickname → fd index.
+    struct alignas(64) NickStripe
+    {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<std::string, int> fds;
+    };
+
+    using FdList = std::shared_ptr<const std::vector<int>>;
+
+    /// A user who belongs to at least one group.
+    struct Member
+    {
+        std::string name;
+        int fd = -1;                        ///< Online connection, -1 if offline
+        std::vector<std::uint32_t> groups; ///< Indices into groups_
+    };
+
+    /// Member ids for bookkeeping plus a copy-on-write snapshot for fan-out.
+    struct Group
+    {
+        std::int64_t db_id;
+        std::string name;
+        std::vector<std::uint32_t> members; ///< Indices into members_
+        FdList online;
+    };
+
+    Database& db_; ///< Shared database reference
+    const std::uint32_t kdf_iterations_;
+    CredentialCache credentials_; ///< Skips the KDF for recent re-logins
+
+    // ── Session table: fd → slot, chunks allocated on first use ────
+
+    std::size_t max_fds_;
+    std::unique_ptr<std::atomic<Slot*>[]> chunks_;
+    std::array<Stripe, kStripes> session_stripes_; ///< Stripe = fd % kStripes
+
+    std::array<NickStripe, kStripes> nick_stripes_; ///< Stripe = hash(nickname) % kStripes
+
+    mutable std::shared_mutex groups_mtx_; ///< Protects the four containers below
+    std::unordered_map<std::string, std::uint32_t> group_ids_;  ///< name → index in groups_
+    std::vector<Group> groups_;
+    std::unordered_map<std::string, std::uint32_t> member_ids_; ///< username → index in members_
+    std::vector<Member> members_;
+
+    std::shared_mutex& sessionLock(int fd) const { return session_stripes_[fd & (kStripes - 1)].mtx; }
+    NickStripe& nickStripe(const std::string& nickname);
+    const NickStripe& nickStripe(const std::string& nickname) const;
+
+    /// @brief Slot for @p fd, or nullptr if out of range / never allocated.
+    Slot* findSlot(int fd) const;
+
+    /// @brief Slot for @p fd, allocating its chunk if needed (nullptr if out of range).
+    Slot* ensureSlot(int fd);
+
+    /// @brief Bind @p username to @p fd unless it is already online elsewhere.
+    bool bindNickname(int fd, const std::string& username);
+
+    /// @brief Record @p username as online on @p fd (or offline if -1) in its groups' snapshots.
+    /// @note Caller holds the username's nickname stripe, so logins and logouts don't interleave.
+    void setMemberFd(const std::string& username, int fd);
+
+    /// @brief Index of @p username in members_, adding it if new. Caller holds groups_mtx_.
+    std::uint32_t memberId(const std::string& username);
 };
\ No newline at end of file
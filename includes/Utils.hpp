@@ -1,32 +1,90 @@
-#pragma once
-
-#include <cstddef>
-#include <string>
-
-/**
- * @brief Set a file descriptor to non-blocking mode (O_NONBLOCK).
- * @param fd File descriptor to modify.
- */
-void set_nonblocking(int fd);
-
-/**
- * @brief Write all bytes to a socket, handling partial writes.
- * @param fd   Target socket.
- * @param data Pointer to data buffer.
- * @param len  Number of bytes to send.
- * @return true if all bytes were sent successfully.
- */
-bool safe_send(int fd, const char* data, std::size_t len);
-
-/// @overload Convenience wrapper for std::string.
-bool safe_send(int fd, const std::string& msg);
-
-/**
- * @brief Produce a simple hex-encoded hash of a password string.
- *
- * @note This uses std::hash — NOT cryptographically secure.
- *       Production systems should use bcrypt / argon2.
- * @param password  Raw password.
- * @return Hex string of the hash.
- */
-std::string hash_password(const std::string& password);
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Set a file descriptor to non-blocking mode (O_NONBLOCK).
+ * @param fd File descriptor to modify.
+ */
+void set_nonblocking(int fd);
+
+/**
+ * @brief Write as much as the socket accepts right now, without blocking.
+ * @param fd   Target (non-blocking) socket.
+ * @param data Pointer to data buffer.
+ * @param len  Number of bytes to send.
+ * @return Bytes written (0 if the socket is full), or -1 on a hard error.
+ */
+ssize_t send_nonblocking(int fd, const char* data, std::size_t len);
+
+/**
+ * @brief Gather-write @p iovcnt buffers in one syscall, without blocking.
+ * @return Bytes written (0 if the socket is full), or -1 on a hard error.
+ */
+ssize_t sendv_nonblocking(int fd, const iovec* iov, int iovcnt);
+
+/**
+ * @brief Write all bytes to a socket, handling partial writes.
+ *
+ * Blocks in poll() while the socket is full, so it is only suitable for
+ * callers that own the thread (tools, tests). The server itself queues
+ * output per connection instead.
+ * @param fd   Target socket.
+ * @param data Pointer to data buffer.
+ * @param len  Number of bytes to send.
+ * @return true if all bytes were sent successfully.
+ */
+bool safe_send(int fd, const char* data, std::size_t len);
+
+/// @overload Convenience wrapper for std::string.
+bool safe_send(int fd, const std::string& msg);
+
+/// @brief Milliseconds on the monotonic clock (for timeouts, never for display).
+std::int64_t monotonic_ms();
+
+/**
+ * @brief Wall-clock milliseconds since the Unix epoch, at timer-tick resolution.
+ *
+ * Reads CLOCK_REALTIME_COARSE, which the kernel keeps updated in the vDSO:
+ * no syscall, no lock, a few nanoseconds. Precise enough to stamp messages.
+ */
+std::int64_t epoch_ms_coarse();
+
+/**
+ * @brief Render epoch milliseconds as local "YYYY-MM-DD HH:MM:SS".
+ *
+ * Each thread caches the date-and-minute prefix, so consecutive stamps
+ * from the same minute skip localtime_r() and its timezone lock.
+ */
+std::string format_epoch_ms(std::int64_t epoch_ms);
+
+/**
+ * @brief Restrict the calling thread to one CPU.
+ * @return false (with errno set) if the CPU does not exist or is not allowed.
+ */
+bool pin_current_thread(int cpu);
+
+/**
+ * @brief Hash a password for storage with a fresh random salt.
+ *
+ * Format: `pbkdf2-sha256$<iterations>$<salt hex>$<key hex>`.
+ * @param password   Raw password.
+ * @param iterations PBKDF2 cost (Config::PASSWORD_KDF_ITERATIONS in the server).
+ * @return The encoded hash, or "" if no randomness was available.
+ */
+std::string hash_password(const std::string& password, std::uint32_t iterations);
+
+/**
+ * @brief Check @p password against a stored hash.
+ *
+ * Also accepts the bare 16-digit hex hashes written before the KDF
+ * existed (std::hash, not cryptographic), so old accounts keep working.
+ * @param[out] needs_rehash Set when the stored hash is legacy or weaker
+ *                          than @p iterations and should be replaced.
+ */
+bool verify_password(const std::string& password, const std::string& stored,
+                     std::uint32_t iterations, bool& needs_rehash);
\ No newline at end of file
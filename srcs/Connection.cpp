@@ -0,0 +1,12 @@
+#include "../includes/Connection.hpp"
+#include "../includes/Config.hpp"
+#include "../includes/Utils.hpp"
+
+Connection::Connection(int fd, int reactor_id)
+    : fd(fd), reactor_id(reactor_id), closed(false),
+      in_buf(Config::MAX_LINE_LENGTH), mode(Protocol::WireMode::Pending),
+      last_activity_ms(monotonic_ms()), timer_deadline_ms(0), ping_sent_ms(0),
+      out_offset(0), out_bytes(0), want_write(false),
+      in_flight(false), paused(false), armed_events(0),
+      auth_pending(false), auth_parked(false), input_held(false),
+      rx_eof(false), rx_throttled(false), send_scheduled(false), send_inflight(false), recv_armed(false), send_msg{} {}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "../includes/CredentialCache.hpp"
+#include "../includes/Utils.hpp"
+
+CredentialCache::CredentialCache(std::size_t capacity, std::int64_t ttl_ms)
+    : capacity_(capacity), ttl_ms_(ttl_ms), key_(Crypto::DIGEST_SIZE, '\0')
+{
+    // Without a key the tags would be guessable offline: run uncached instead
+    if (capacity_ > 0 && !Crypto::randomBytes(&key_[0], key_.size()))
+        capacity_ = 0;
+}
+
+Crypto::Digest CredentialCache::tagFor(const std::string& username, const std::string& password) const
+{
+    std::string msg;
+    msg.reserve(username.size() + 1 + password.size());
+    msg.append(username).push_back('\0');
+    msg.append(password);
+    return Crypto::hmacSha256(key_, msg);
+}
+
+bool CredentialCache::check(const std::string& username, const std::string& password)
+{
+    if (capacity_ == 0) return false;
+
+    Crypto::Digest tag = tagFor(username, password);
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = entries_.find(username);
+    if (it == entries_.end() || it->second.expires_ms <= monotonic_ms() ||
+        !Crypto::constantTimeEqual(it->second.tag.data(), tag.data(), tag.size()))
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void CredentialCache::remember(const std::string& username, const std::string& password)
+{
+    if (capacity_ == 0) return;
+
+    Crypto::Digest tag = tagFor(username, password);
+    std::int64_t expires = monotonic_ms() + ttl_ms_;
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = entries_.find(username);
+    if (it != entries_.end())
+    {
+        it->second.tag = tag;
+        it->second.expires_ms = expires;
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return;
+    }
+
+    if (entries_.size() >= capacity_)
+    {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(username);
+    entries_.emplace(username, Entry{tag, expires, lru_.begin()});
+}
+
+void CredentialCache::forget(const std::string& username)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = entries_.find(username);
+    if (it == entries_.end()) return;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
\ No newline at end of file
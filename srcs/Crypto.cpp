@@ -0,0 +1,277 @@
+#include "../includes/Crypto.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/random.h>
+
+namespace Crypto
+{
+    namespace
+    {
+        const std::uint32_t kRound[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        const std::uint32_t kInit[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+        std::uint32_t rotr(std::uint32_t x, unsigned n) { return (x >> n) | (x << (32 - n)); }
+
+        std::uint32_t load32(const std::uint8_t* p)
+        {
+            return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+                   (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+        }
+
+        void store32(std::uint8_t* p, std::uint32_t v)
+        {
+            p[0] = static_cast<std::uint8_t>(v >> 24);
+            p[1] = static_cast<std::uint8_t>(v >> 16);
+            p[2] = static_cast<std::uint8_t>(v >> 8);
+            p[3] = static_cast<std::uint8_t>(v);
+        }
+
+        /// HMAC key schedule: the inner and outer hashes after absorbing the padded key.
+        struct HmacKey
+        {
+            Sha256 inner;
+            Sha256 outer;
+
+            explicit HmacKey(std::string_view key)
+            {
+                std::uint8_t k[64] = {};
+                if (key.size() > sizeof(k))
+                {
+                    Sha256 h;
+                    h.update(key);
+                    h.finish(k);
+                }
+                else
+                {
+                    std::memcpy(k, key.data(), key.size());
+                }
+
+                std::uint8_t pad[64];
+                for (std::size_t i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x36;
+                inner.update(pad, 64);
+                for (std::size_t i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x5c;
+                outer.update(pad, 64);
+            }
+
+            /// One HMAC over @p len bytes, reusing the precomputed pads.
+            void mac(const std::uint8_t* msg, std::size_t len, std::uint8_t* out) const
+            {
+                Sha256 i = inner;
+                i.update(msg, len);
+                std::uint8_t tmp[DIGEST_SIZE];
+                i.finish(tmp);
+                Sha256 o = outer;
+                o.update(tmp, DIGEST_SIZE);
+                o.finish(out);
+            }
+        };
+    }
+
+    // ── SHA-256 ─────────────────────────────────────────────────────
+
+    Sha256::Sha256()
+    {
+        std::memcpy(state_, kInit, sizeof(state_));
+    }
+
+    void Sha256::compress(const std::uint8_t* block)
+    {
+        std::uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = load32(block + 4 * i);
+        for (int i = 16; i < 64; ++i)
+        {
+            std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        std::uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+        std::uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+        for (int i = 0; i < 64; ++i)
+        {
+            std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                               ((e & f) ^ (~e & g)) + kRound[i] + w[i];
+            std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                               ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state_[0] += a;
+        state_[1] += b;
+        state_[2] += c;
+        state_[3] += d;
+        state_[4] += e;
+        state_[5] += f;
+        state_[6] += g;
+        state_[7] += h;
+    }
+
+    void Sha256::update(const void* data, std::size_t len)
+    {
+        const auto* p = static_cast<const std::uint8_t*>(data);
+        total_ += len;
+
+        if (fill_ > 0)
+        {
+            std::size_t take = std::min(len, sizeof(block_) - fill_);
+            std::memcpy(block_ + fill_, p, take);
+            fill_ += take;
+            p += take;
+            len -= take;
+            if (fill_ < sizeof(block_)) return;
+            compress(block_);
+            fill_ = 0;
+        }
+        for (; len >= 64; p += 64, len -= 64)
+            compress(p);
+        std::memcpy(block_, p, len);
+        fill_ = len;
+    }
+
+    void Sha256::finish(std::uint8_t* out)
+    {
+        std::uint64_t bits = total_ * 8;
+        block_[fill_++] = 0x80;
+        if (fill_ > 56)
+        {
+            std::memset(block_ + fill_, 0, 64 - fill_);
+            compress(block_);
+            fill_ = 0;
+        }
+        std::memset(block_ + fill_, 0, 56 - fill_);
+        for (int i = 0; i < 8; ++i)
+            block_[56 + i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+        compress(block_);
+
+        for (int i = 0; i < 8; ++i)
+            store32(out + 4 * i, state_[i]);
+    }
+
+    Digest sha256(std::string_view data)
+    {
+        Digest d;
+        Sha256 h;
+        h.update(data);
+        h.finish(d.data());
+        return d;
+    }
+
+    // ── HMAC / PBKDF2 ───────────────────────────────────────────────
+
+    Digest hmacSha256(std::string_view key, std::string_view message)
+    {
+        Digest d;
+        HmacKey(key).mac(reinterpret_cast<const std::uint8_t*>(message.data()), message.size(),
+                         d.data());
+        return d;
+    }
+
+    void pbkdf2Sha256(std::string_view password, std::string_view salt, std::uint32_t iterations,
+                      std::uint8_t* out, std::size_t out_len)
+    {
+        const HmacKey key(password);
+        std::string first(salt);
+        first.resize(salt.size() + 4);
+
+        for (std::uint32_t block = 1; out_len > 0; ++block)
+        {
+            // U1 = HMAC(P, S || INT(i)), Uj = HMAC(P, Uj-1), T = U1 ^ ... ^ Uc
+            store32(reinterpret_cast<std::uint8_t*>(&first[salt.size()]), block);
+            std::uint8_t u[DIGEST_SIZE];
+            std::uint8_t t[DIGEST_SIZE];
+            key.mac(reinterpret_cast<const std::uint8_t*>(first.data()), first.size(), u);
+            std::memcpy(t, u, DIGEST_SIZE);
+            for (std::uint32_t j = 1; j < iterations; ++j)
+            {
+                key.mac(u, DIGEST_SIZE, u);
+                for (std::size_t k = 0; k < DIGEST_SIZE; ++k) t[k] ^= u[k];
+            }
+
+            std::size_t take = std::min(out_len, DIGEST_SIZE);
+            std::memcpy(out, t, take);
+            out += take;
+            out_len -= take;
+        }
+    }
+
+    // ── Helpers ─────────────────────────────────────────────────────
+
+    bool randomBytes(void* out, std::size_t len)
+    {
+        auto* p = static_cast<std::uint8_t*>(out);
+        while (len > 0)
+        {
+            ssize_t n = getrandom(p, len, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            len -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    std::string toHex(const std::uint8_t* data, std::size_t len)
+    {
+        static const char kDigits[] = "0123456789abcdef";
+        std::string out(len * 2, '\0');
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            out[2 * i] = kDigits[data[i] >> 4];
+            out[2 * i + 1] = kDigits[data[i] & 0xf];
+        }
+        return out;
+    }
+
+    bool fromHex(std::string_view hex, std::string& out)
+    {
+        auto nibble = [](char c) -> int
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+
+        if (hex.size() % 2 != 0) return false;
+        out.resize(hex.size() / 2);
+        for (std::size_t i = 0; i < out.size(); ++i)
+        {
+            int hi = nibble(hex[2 * i]);
+            int lo = nibble(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) return false;
+            out[i] = static_cast<char>((hi << 4) | lo);
+        }
+        return true;
+    }
+
+    bool constantTimeEqual(const std::uint8_t* a, const std::uint8_t* b, std::size_t len)
+    {
+        std::uint8_t diff = 0;
+        for (std::size_t i = 0; i < len; ++i)
+            diff |= a[i] ^ b[i];
+        return diff == 0;
+    }
+}
\ No newline at end of file
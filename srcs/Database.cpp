@@ -1,185 +1,1181 @@
-#include "../includes/Database.hpp"
-
-#include <ctime>
-#include <iostream>
-
-Database::Database() : db(nullptr) {}
-
-Database::~Database() { close(); }
-
-bool Database::open(const std::string& db_filename)
-{
-    std::lock_guard<std::mutex> lock(mtx);
-    if (db) return true; // already open
-
-    if (sqlite3_open(db_filename.c_str(), &db) != SQLITE_OK)
-    {
-        std::cerr << "[DB] Failed to open: " << sqlite3_errmsg(db) << "\n";
-        db = nullptr;
-        return false;
-    }
-
-    // Enable WAL mode for better concurrent read performance
-    sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
-
-    std::cout << "[DB] Opened " << db_filename << "\n";
-    return initTables();
-}
-
-void Database::close()
-{
-    std::lock_guard<std::mutex> lock(mtx);
-    if (db)
-    {
-        sqlite3_close(db);
-        db = nullptr;
-    }
-}
-
-bool Database::initTables()
-{
-    const char* sql_messages =
-        "CREATE TABLE IF NOT EXISTS messages ("
-        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "  sender   TEXT NOT NULL,"
-        "  receiver TEXT NOT NULL,"
-        "  content  TEXT NOT NULL,"
-        "  type     TEXT NOT NULL,"
-        "  timestamp TEXT NOT NULL"
-        ");";
-
-    const char* sql_users =
-        "CREATE TABLE IF NOT EXISTS users ("
-        "  username      TEXT PRIMARY KEY,"
-        "  password_hash TEXT NOT NULL"
-        ");";
-
-    char* err = nullptr;
-    if (sqlite3_exec(db, sql_messages, nullptr, nullptr, &err) != SQLITE_OK)
-    {
-        std::cerr << "[DB] Create messages table: " << err << "\n";
-        sqlite3_free(err);
-        return false;
-    }
-    if (sqlite3_exec(db, sql_users, nullptr, nullptr, &err) != SQLITE_OK)
-    {
-        std::cerr << "[DB] Create users table: " << err << "\n";
-        sqlite3_free(err);
-        return false;
-    }
-    return true;
-}
-
-// ── Messages ────────────────────────────────────────────────────────
-
-bool Database::insertMessage(const std::string& sender,
-                             const std::string& receiver,
-                             const std::string& content,
-                             const std::string& type)
-{
-    std::lock_guard<std::mutex> lock(mtx);
-    if (!db) return false;
-
-    const char* sql =
-        "INSERT INTO messages (sender, receiver, content, type, timestamp) "
-        "VALUES (?, ?, ?, ?, ?);";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
-        return false;
-
-    sqlite3_bind_text(stmt, 1, sender.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, receiver.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, content.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, type.c_str(), -1, SQLITE_TRANSIENT);
-
-    char ts[20];
-    std::time_t now = std::time(nullptr);
-    std::strftime(ts, sizeof(ts), "%F %T", std::localtime(&now));
-    sqlite3_bind_text(stmt, 5, ts, -1, SQLITE_TRANSIENT);
-
-    bool ok = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
-    return ok;
-}
-
-std::vector<ChatMessage> Database::getRecentMessages(int limit) const
-{
-    std::lock_guard<std::mutex> lock(mtx);
-    std::vector<ChatMessage> result;
-    if (!db) return result;
-
-    const char* sql =
-        "SELECT sender, receiver, content, type, timestamp "
-        "FROM messages ORDER BY id DESC LIMIT ?;";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
-        return result;
-
-    sqlite3_bind_int(stmt, 1, limit);
-
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-        ChatMessage m;
-        m.sender = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        m.receiver = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        m.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        m.type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        m.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        result.push_back(std::move(m));
-    }
-
-    sqlite3_finalize(stmt);
-    return result;
-}
-
-// ── Users ───────────────────────────────────────────────────────────
-
-bool Database::insertUser(const std::string& username,
-                          const std::string& password_hash)
-{
-    std::lock_guard<std::mutex> lock(mtx);
-    if (!db) return false;
-
-    const char* sql = "INSERT OR IGNORE INTO users (username, password_hash) VALUES (?, ?);";
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
-        return false;
-
-    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, password_hash.c_str(), -1, SQLITE_TRANSIENT);
-
-    bool ok = (sqlite3_step(stmt) == SQLITE_DONE) && (sqlite3_changes(db) > 0);
-    sqlite3_finalize(stmt);
-    return ok;
-}
-
-bool Database::getUserPasswordHash(const std::string& username,
-                                   std::string& out_hash) const
-{
-    std::lock_guard<std::mutex> lock(mtx);
-    if (!db) return false;
-
-    const char* sql = "SELECT password_hash FROM users WHERE username = ?;";
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
-        return false;
-
-    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
-
-    bool found = false;
-    if (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-        out_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        found = true;
-    }
-    sqlite3_finalize(stmt);
-    return found;
-}
-
-bool Database::userExists(const std::string& username) const
-{
-    std::string dummy;
-    return getUserPasswordHash(username, dummy);
+#include "../includes/Database.hpp"
+#include "../includes/Metrics.hpp"
+#include "../includes/Utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <unordered_set>
+
+namespace
+{
+    constexpr int kRetryMinMs = 10;   ///< First pause after a failed batch commit
+    constexpr int kRetryMaxMs = 1000; ///< Backoff ceiling while the batch is kept
+    constexpr int kStopAttempts = 3;  ///< Tries left for a batch once stop() is waiting
+    constexpr int kBusyTimeoutMs = 5000;
+
+    /// @brief Step a SELECT of (id, sender, receiver, content, type, timestamp) into @p out.
+    void readMessages(sqlite3_stmt* stmt, std::vector<ChatMessage>& out)
+    {
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            ChatMessage m;
+            m.id = sqlite3_column_int64(stmt, 0);
+            m.sender = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            m.receiver = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            m.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            m.type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+            m.timestamp_ms = sqlite3_column_int64(stmt, 5);
+            out.push_back(std::move(m));
+        }
+        sqlite3_reset(stmt); // end the read transaction so WAL can checkpoint
+    }
+
+    /// @brief Open one connection with the pragmas every handle needs.
+    sqlite3* openConnection(const std::string& filename, int flags)
+    {
+        sqlite3* conn = nullptr;
+        if (sqlite3_open_v2(filename.c_str(), &conn, flags, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "[DB] Failed to open: " << sqlite3_errmsg(conn) << "\n";
+            sqlite3_close(conn);
+            return nullptr;
+        }
+
+        // Wait out short write locks (e.g. checkpoints) instead of failing
+        sqlite3_busy_timeout(conn, kBusyTimeoutMs);
+        return conn;
+    }
+}
+
+// ── Connection handles ──────────────────────────────────────────────
+
+sqlite3_stmt* Database::DbHandle::prepare(const char* sql)
+{
+    auto it = stmts.find(sql);
+    if (it != stmts.end())
+    {
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Prepare failed: " << sqlite3_errmsg(db) << "\n";
+        return nullptr;
+    }
+    stmts.emplace(sql, stmt);
+    return stmt;
+}
+
+void Database::DbHandle::close()
+{
+    for (auto& [sql, stmt] : stmts)
+        sqlite3_finalize(stmt);
+    stmts.clear();
+
+    if (db)
+    {
+        sqlite3_close(db);
+        db = nullptr;
+    }
+}
+
+template <typename Fn>
+auto Database::withReader(Fn&& fn) const
+{
+    if (readers_.empty())
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return fn(const_cast<DbHandle&>(writer_));
+    }
+
+    DbHandle* handle;
+    {
+        std::unique_lock<std::mutex> lock(reader_mtx_);
+        reader_cv_.wait(lock, [this]
+                        { return !idle_readers_.empty(); });
+        handle = idle_readers_.back();
+        idle_readers_.pop_back();
+    }
+
+    struct Release
+    {
+        const Database* self;
+        DbHandle* handle;
+        ~Release()
+        {
+            {
+                std::lock_guard<std::mutex> lock(self->reader_mtx_);
+                self->idle_readers_.push_back(handle);
+            }
+            self->reader_cv_.notify_one();
+        }
+    } release{this, handle};
+
+    return fn(*handle);
+}
+
+// ── Lifecycle ───────────────────────────────────────────────────────
+
+Database::Database() = default;
+
+Database::~Database()
+{
+    close();
+
+    // Anything pushed after the final drain never reaches disk
+    PendingMessage* node = pending_head_.exchange(nullptr);
+    while (node)
+    {
+        PendingMessage* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+bool Database::open(const std::string& db_filename,
+                    std::size_t write_batch,
+                    int flush_interval_ms,
+                    std::size_t reader_pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (writer_.db) return true; // already open
+
+        writer_.db = openConnection(db_filename, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+        if (!writer_.db) return false;
+
+        // Must precede the first table; on older files it stays off until a full VACUUM
+        sqlite3_exec(writer_.db, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+
+        // Enable WAL mode so the reader pool never blocks behind the writer
+        sqlite3_exec(writer_.db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+
+        // Backstop for truncateWal(): cut the WAL back whenever it is reused
+        std::string size_limit = "PRAGMA journal_size_limit=" + std::to_string(Config::WAL_SIZE_LIMIT) + ";";
+        sqlite3_exec(writer_.db, size_limit.c_str(), nullptr, nullptr, nullptr);
+
+        std::cout << "[DB] Opened " << db_filename << "\n";
+        if (!initTables()) return false;
+
+        // Ids are assigned in-process so queued messages already have one.
+        // Start above the AUTOINCREMENT high-water mark, which retention
+        // never lowers, so a pruned id is not handed out again.
+        static const char* kNextId =
+            "SELECT MAX(COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'messages'), 0),"
+            "           COALESCE((SELECT MAX(id) FROM messages), 0));";
+        sqlite3_stmt* max_id = nullptr;
+        if (sqlite3_prepare_v2(writer_.db, kNextId, -1, &max_id, nullptr) == SQLITE_OK &&
+            sqlite3_step(max_id) == SQLITE_ROW)
+        {
+            std::lock_guard<std::mutex> seq(sequence_mtx_);
+            next_message_id_ = sqlite3_column_int64(max_id, 0) + 1;
+        }
+        sqlite3_finalize(max_id);
+
+        // Each reader is used by one thread at a time, so skip SQLite's mutex
+        bool shared_file = db_filename != ":memory:" && !db_filename.empty();
+        if (shared_file)
+        {
+            std::lock_guard<std::mutex> clock(checkpointer_mtx_);
+            checkpointer_.db = openConnection(db_filename, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX);
+            // A connection only sees WAL mode once it has read the file; until
+            // then sqlite3_wal_checkpoint_v2() succeeds without doing anything
+            if (checkpointer_.db)
+                sqlite3_exec(checkpointer_.db, "PRAGMA journal_mode;", nullptr, nullptr, nullptr);
+        }
+        for (std::size_t i = 0; shared_file && i < reader_pool; ++i)
+        {
+            sqlite3* conn = openConnection(db_filename, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX);
+            if (!conn) break;
+            readers_.emplace_back();
+            readers_.back().db = conn;
+        }
+        std::lock_guard<std::mutex> rlock(reader_mtx_);
+        for (auto& r : readers_)
+            idle_readers_.push_back(&r);
+    }
+
+    // Warm the ring; one extra row tells us whether it saw everything
+    std::size_t cache_size = history_cache_.capacity();
+    if (cache_size > 0)
+    {
+        auto rows = queryRecentMessages(static_cast<int>(cache_size) + 1);
+        history_cache_.warm(rows, rows.size() <= cache_size);
+    }
+
+    write_batch_ = write_batch > 0 ? write_batch : 1;
+    flush_interval_ms_ = flush_interval_ms;
+    writer_stop_.store(false);
+    accepting_.store(true);
+    writer_thread_ = std::thread(&Database::writerLoop, this);
+    return true;
+}
+
+void Database::close()
+{
+    // Stop accepting, let the writer drain what is queued, then close
+    accepting_.store(false);
+    if (writer_thread_.joinable())
+    {
+        writer_stop_.store(true);
+        wakeWriter();
+        writer_thread_.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> rlock(reader_mtx_);
+        reader_cv_.wait(rlock, [this]
+                        { return idle_readers_.size() == readers_.size(); });
+        idle_readers_.clear();
+        for (auto& r : readers_)
+            r.close();
+        readers_.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> clock(checkpointer_mtx_);
+        checkpointer_.close();
+    }
+
+    // Closing the last connection checkpoints and removes the WAL
+    std::lock_guard<std::mutex> lock(mtx);
+    writer_.close();
+}
+
+bool Database::initTables()
+{
+    const char* sql_messages =
+        "CREATE TABLE IF NOT EXISTS messages ("
+        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  sender   TEXT NOT NULL,"
+        "  receiver TEXT NOT NULL,"
+        "  content  TEXT NOT NULL,"
+        "  type     TEXT NOT NULL,"
+        "  timestamp INTEGER NOT NULL" // Unix epoch milliseconds
+        ");";
+
+    const char* sql_users =
+        "CREATE TABLE IF NOT EXISTS users ("
+        "  username      TEXT PRIMARY KEY,"
+        "  password_hash TEXT NOT NULL"
+        ");";
+
+    // Membership is keyed by username so it survives reconnects; the
+    // (username, group_id) index serves "which groups is this user in"
+    const char* sql_groups =
+        "CREATE TABLE IF NOT EXISTS chat_groups ("
+        "  id   INTEGER PRIMARY KEY,"
+        "  name TEXT NOT NULL UNIQUE"
+        ");"
+        "CREATE TABLE IF NOT EXISTS group_members ("
+        "  group_id INTEGER NOT NULL REFERENCES chat_groups(id),"
+        "  username TEXT NOT NULL,"
+        "  PRIMARY KEY (group_id, username)"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS idx_group_members_username"
+        "  ON group_members (username, group_id);";
+
+    // Undelivered private messages per recipient; the message_id index lets
+    // retention drop entries whose message was pruned
+    const char* sql_offline =
+        "CREATE TABLE IF NOT EXISTS offline_queue ("
+        "  recipient  TEXT NOT NULL,"
+        "  message_id INTEGER NOT NULL,"
+        "  PRIMARY KEY (recipient, message_id)"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS idx_offline_queue_message"
+        "  ON offline_queue (message_id);";
+
+    // One range scan per history source: (type, receiver) covers broadcasts,
+    // received private messages and groups; (type, sender) sent private ones
+    const char* sql_indexes =
+        "CREATE INDEX IF NOT EXISTS idx_messages_type_receiver_id"
+        "  ON messages (type, receiver, id);"
+        "CREATE INDEX IF NOT EXISTS idx_messages_type_sender_id"
+        "  ON messages (type, sender, id);"
+        "CREATE INDEX IF NOT EXISTS idx_messages_timestamp"
+        "  ON messages (timestamp);";
+
+    char* err = nullptr;
+    if (sqlite3_exec(writer_.db, sql_messages, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Create messages table: " << err << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    if (!migrateTimestamps()) return false;
+    if (sqlite3_exec(writer_.db, sql_indexes, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Create message indexes: " << err << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    if (sqlite3_exec(writer_.db, sql_users, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Create users table: " << err << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    if (sqlite3_exec(writer_.db, sql_groups, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Create group tables: " << err << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    if (sqlite3_exec(writer_.db, sql_offline, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Create offline queue: " << err << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+bool Database::migrateTimestamps()
+{
+    // Older files declare `timestamp TEXT` holding local "YYYY-MM-DD HH:MM:SS"
+    bool legacy = false;
+    sqlite3_stmt* info = nullptr;
+    if (sqlite3_prepare_v2(writer_.db, "PRAGMA table_info(messages);", -1, &info, nullptr) != SQLITE_OK)
+        return false;
+    while (sqlite3_step(info) == SQLITE_ROW)
+    {
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(info, 1));
+        const char* type = reinterpret_cast<const char*>(sqlite3_column_text(info, 2));
+        if (name && type && std::string_view(name) == "timestamp" && std::string_view(type) == "TEXT")
+            legacy = true;
+    }
+    sqlite3_finalize(info);
+    if (!legacy) return true;
+
+    // TEXT affinity would turn integers back into strings, so the table is
+    // rebuilt; 'utc' reads the old stamps as local time. The old indexes go
+    // with the old table and initTables() recreates them.
+    const char* sql_migrate =
+        "BEGIN;"
+        "CREATE TABLE messages_epoch ("
+        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  sender   TEXT NOT NULL,"
+        "  receiver TEXT NOT NULL,"
+        "  content  TEXT NOT NULL,"
+        "  type     TEXT NOT NULL,"
+        "  timestamp INTEGER NOT NULL"
+        ");"
+        "INSERT INTO messages_epoch (id, sender, receiver, content, type, timestamp) "
+        "  SELECT id, sender, receiver, content, type,"
+        "         COALESCE(CAST(strftime('%s', timestamp, 'utc') AS INTEGER) * 1000, 0)"
+        "  FROM messages;"
+        "DROP TABLE messages;"
+        "ALTER TABLE messages_epoch RENAME TO messages;"
+        "COMMIT;";
+
+    std::cout << "[DB] Migrating message timestamps to epoch milliseconds\n";
+    char* err = nullptr;
+    if (sqlite3_exec(writer_.db, sql_migrate, nullptr, nullptr, &err) != SQLITE_OK)
+    {
+        std::cerr << "[DB] Migrate timestamps: " << err << "\n";
+        sqlite3_free(err);
+        sqlite3_exec(writer_.db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+// ── Messages ────────────────────────────────────────────────────────
+
+bool Database::insertMessage(const std::string& sender,
+                             const std::string& receiver,
+                             const std::string& content,
+                             const std::string& type)
+{
+    return enqueueMessage(sender, receiver, content, type, false);
+}
+
+bool Database::enqueueMessage(const std::string& sender,
+                              const std::string& receiver,
+                              const std::string& content,
+                              const std::string& type,
+                              bool offline)
+{
+    if (!accepting_.load(std::memory_order_relaxed)) return false;
+
+    auto* node = new PendingMessage;
+    node->offline = offline;
+    node->msg.sender = sender;
+    node->msg.receiver = receiver;
+    node->msg.content = content;
+    node->msg.type = type;
+
+    // Stamp at enqueue time so batching does not skew the timestamp;
+    // rendering to local time waits until someone reads the history
+    node->msg.timestamp_ms = epoch_ms_coarse();
+    {
+        std::lock_guard<std::mutex> seq(sequence_mtx_);
+        node->msg.id = next_message_id_++;
+        history_cache_.push(node->msg);
+    }
+
+    // Visible to offlineMessages() before the writer can see the node
+    if (offline)
+    {
+        std::lock_guard<std::mutex> lock(offline_mtx_);
+        offline_unwritten_[receiver].push_back(node->msg);
+    }
+
+    // Counted before the push, so the writer never drains more than it sees here
+    std::size_t count = pending_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // Lock-free push; the writer takes the whole stack in one exchange
+    node->next = pending_head_.load(std::memory_order_relaxed);
+    while (!pending_head_.compare_exchange_weak(node->next, node,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+    {
+    }
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+
+    // Only the transitions the writer is waiting on need a wakeup
+    if (count == 1 || count == write_batch_)
+        wakeWriter();
+    return true;
+}
+
+void Database::flush()
+{
+    std::uint64_t target = enqueued_.load();
+    std::unique_lock<std::mutex> lock(writer_mtx_);
+    if (!writer_thread_.joinable()) return;
+
+    ++flush_waiters_;
+    writer_cv_.notify_one();
+    flushed_cv_.wait(lock, [&]
+                     { return committed_.load() >= target || writer_stop_.load(); });
+    --flush_waiters_;
+}
+
+void Database::wakeWriter()
+{
+    // Taking the lock orders us after the writer's predicate check
+    {
+        std::lock_guard<std::mutex> lock(writer_mtx_);
+    }
+    writer_cv_.notify_one();
+}
+
+void Database::writerLoop()
+{
+    std::vector<ChatMessage> batch;
+    std::vector<std::size_t> offline; ///< Positions in batch bound for offline_queue
+    batch.reserve(write_batch_);
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(writer_mtx_);
+            writer_cv_.wait(lock, [this]
+                            { return writer_stop_.load() || pending_count_.load() > 0; });
+
+            // Group commit: give the batch up to flush_interval_ms_ to fill
+            writer_cv_.wait_for(lock, std::chrono::milliseconds(flush_interval_ms_), [this]
+                                { return writer_stop_.load() || flush_waiters_ > 0 ||
+                                         pending_count_.load() >= write_batch_; });
+        }
+
+        // Take everything queued so far and restore FIFO order
+        PendingMessage* node = pending_head_.exchange(nullptr, std::memory_order_acquire);
+        PendingMessage* fifo = nullptr;
+        while (node)
+        {
+            PendingMessage* next = node->next;
+            node->next = fifo;
+            fifo = node;
+            node = next;
+        }
+
+        std::size_t drained = 0;
+        while (fifo)
+        {
+            if (fifo->offline) offline.push_back(batch.size());
+            batch.push_back(std::move(fifo->msg));
+            PendingMessage* next = fifo->next;
+            delete fifo;
+            fifo = next;
+            ++drained;
+
+            if (batch.size() == write_batch_ || !fifo)
+            {
+                commitBatch(batch, offline);
+                batch.clear();
+                offline.clear();
+            }
+        }
+
+        pending_count_.fetch_sub(drained, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(writer_mtx_);
+            committed_.fetch_add(drained);
+        }
+        flushed_cv_.notify_all();
+
+        if (writer_stop_.load() && !pending_head_.load()) break;
+    }
+}
+
+void Database::commitBatch(const std::vector<ChatMessage>& batch,
+                           const std::vector<std::size_t>& offline)
+{
+    int backoff_ms = kRetryMinMs;
+    for (int attempt = 1;; ++attempt)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            std::uint64_t start = Metrics::nowNs();
+            if (writeBatch(batch, offline))
+            {
+                Metrics::record(Metrics::Latency::DbCommit, Metrics::nowNs() - start);
+                Metrics::add(Metrics::Counter::DbRowsWritten, batch.size());
+                return;
+            }
+        }
+
+        // Nothing was written; keep the batch unless shutdown cannot wait for it
+        if (writer_stop_.load() && attempt >= kStopAttempts)
+        {
+            std::cerr << "[DB] Dropping batch of " << batch.size() << " message(s) at shutdown\n";
+            return;
+        }
+        std::unique_lock<std::mutex> lock(writer_mtx_);
+        writer_cv_.wait_for(lock, std::chrono::milliseconds(backoff_ms), [this]
+                            { return writer_stop_.load(); });
+        backoff_ms = std::min(backoff_ms * 2, kRetryMaxMs);
+    }
+}
+
+bool Database::writeBatch(const std::vector<ChatMessage>& batch,
+                          const std::vector<std::size_t>& offline)
+{
+    if (!writer_.db) return true; // closed: nowhere to keep it
+
+    static const char* kBegin = "BEGIN IMMEDIATE;";
+    static const char* kCommit = "COMMIT;";
+    static const char* kRollback = "ROLLBACK;";
+    static const char* kInsert =
+        "INSERT INTO messages (id, sender, receiver, content, type, timestamp) "
+        "VALUES (?, ?, ?, ?, ?, ?);";
+
+    sqlite3_stmt* insert = writer_.prepare(kInsert);
+    sqlite3_stmt* begin = writer_.prepare(kBegin);
+    if (!insert || !begin) return false;
+
+    // Without the transaction every insert would commit on its own
+    if (sqlite3_step(begin) != SQLITE_DONE)
+    {
+        std::cerr << "[DB] Begin batch of " << batch.size() << ": "
+                  << sqlite3_errmsg(writer_.db) << "\n";
+        return false;
+    }
+    for (const auto& m : batch)
+    {
+        sqlite3_reset(insert);
+        sqlite3_bind_int64(insert, 1, m.id);
+        sqlite3_bind_text(insert, 2, m.sender.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(insert, 3, m.receiver.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(insert, 4, m.content.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(insert, 5, m.type.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(insert, 6, m.timestamp_ms);
+
+        if (sqlite3_step(insert) != SQLITE_DONE)
+            std::cerr << "[DB] Insert message: " << sqlite3_errmsg(writer_.db) << "\n";
+    }
+    sqlite3_reset(insert);
+    sqlite3_clear_bindings(insert);
+
+    // Under offline_mtx_ until the commit: a login in between either sees
+    // the entry in offline_unwritten_ or, after it, the committed row
+    std::unique_lock<std::mutex> olock(offline_mtx_, std::defer_lock);
+    std::vector<std::size_t> queued; ///< Leave offline_unwritten_ once committed
+    if (!offline.empty())
+    {
+        static const char* kQueue =
+            "INSERT OR IGNORE INTO offline_queue (recipient, message_id) VALUES (?, ?);";
+        olock.lock();
+        if (sqlite3_stmt* queue = writer_.prepare(kQueue))
+        {
+            for (std::size_t i : offline)
+            {
+                // Gone from the map: delivered at a login before we got here
+                auto it = offline_unwritten_.find(batch[i].receiver);
+                if (it == offline_unwritten_.end()) continue;
+                const auto& waiting = it->second;
+                if (std::none_of(waiting.begin(), waiting.end(), [&](const ChatMessage& m)
+                                 { return m.id == batch[i].id; }))
+                    continue;
+                queued.push_back(i);
+
+                sqlite3_reset(queue);
+                sqlite3_bind_text(queue, 1, batch[i].receiver.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int64(queue, 2, batch[i].id);
+                if (sqlite3_step(queue) != SQLITE_DONE)
+                    std::cerr << "[DB] Queue offline message: " << sqlite3_errmsg(writer_.db) << "\n";
+            }
+            sqlite3_reset(queue);
+            sqlite3_clear_bindings(queue);
+        }
+    }
+
+    sqlite3_stmt* commit = writer_.prepare(kCommit);
+    if (!commit || sqlite3_step(commit) != SQLITE_DONE)
+    {
+        std::cerr << "[DB] Commit batch of " << batch.size() << ": "
+                  << sqlite3_errmsg(writer_.db) << "\n";
+        if (sqlite3_stmt* rollback = writer_.prepare(kRollback))
+            sqlite3_step(rollback);
+        return false;
+    }
+
+    for (std::size_t i : queued)
+    {
+        auto it = offline_unwritten_.find(batch[i].receiver);
+        auto& waiting = it->second;
+        waiting.erase(std::remove_if(waiting.begin(), waiting.end(), [&](const ChatMessage& m)
+                                     { return m.id == batch[i].id; }),
+                      waiting.end());
+        if (waiting.empty()) offline_unwritten_.erase(it);
+    }
+    return true;
+}
+
+std::vector<ChatMessage> Database::getRecentMessages(int limit) const
+{
+    std::vector<ChatMessage> cached;
+    if (history_cache_.recent(limit, 0, [](const ChatMessage&)
+                              { return true; },
+                              cached))
+        return cached;
+    return queryRecentMessages(limit);
+}
+
+std::vector<ChatMessage> Database::queryRecentMessages(int limit) const
+{
+    static const char* kSql =
+        "SELECT id, sender, receiver, content, type, timestamp "
+        "FROM messages ORDER BY id DESC LIMIT ?;";
+
+    return withReader([&](DbHandle& h)
+                      {
+        std::vector<ChatMessage> result;
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return result;
+
+        sqlite3_bind_int(stmt, 1, limit);
+        readMessages(stmt, result);
+        return result; });
+}
+
+std::vector<ChatMessage> Database::getVisibleMessages(const std::string& viewer,
+                                                      const std::vector<std::string>& groups,
+                                                      int limit,
+                                                      std::int64_t before_id) const
+{
+    // Hashed once per page so each cached row costs one lookup
+    const std::unordered_set<std::string_view> joined(groups.begin(), groups.end());
+    auto visible = [&](const ChatMessage& m)
+    {
+        if (m.type == "broadcast") return true;
+        if (m.type == "private") return m.sender == viewer || m.receiver == viewer;
+        if (m.type == "group") return joined.count(m.receiver) > 0;
+        return false;
+    };
+
+    std::vector<ChatMessage> cached;
+    if (history_cache_.recent(limit, before_id, visible, cached))
+        return cached;
+    return queryVisibleMessages(viewer, groups, limit, before_id);
+}
+
+std::vector<ChatMessage> Database::queryVisibleMessages(const std::string& viewer,
+                                                        const std::vector<std::string>& groups,
+                                                        int limit,
+                                                        std::int64_t before_id) const
+{
+    static const char* kByReceiver =
+        "SELECT id, sender, receiver, content, type, timestamp FROM messages "
+        "WHERE type = ? AND receiver = ? AND id < ? ORDER BY id DESC LIMIT ?;";
+    static const char* kBySender =
+        "SELECT id, sender, receiver, content, type, timestamp FROM messages "
+        "WHERE type = ? AND sender = ? AND id < ? ORDER BY id DESC LIMIT ?;";
+
+    std::int64_t cursor = before_id > 0 ? before_id : std::numeric_limits<std::int64_t>::max();
+
+    return withReader([&](DbHandle& h)
+                      {
+        std::vector<ChatMessage> result;
+        if (!h.db) return result;
+
+        // Each source yields at most `limit` rows from its own index range
+        auto scan = [&](const char* sql, const char* type, const std::string& who)
+        {
+            sqlite3_stmt* stmt = h.prepare(sql);
+            if (!stmt) return;
+            sqlite3_bind_text(stmt, 1, type, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, who.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 3, cursor);
+            sqlite3_bind_int(stmt, 4, limit);
+            readMessages(stmt, result);
+        };
+
+        scan(kByReceiver, "broadcast", "ALL");
+        scan(kByReceiver, "private", viewer);
+        scan(kBySender, "private", viewer);
+        for (const auto& g : groups)
+            scan(kByReceiver, "group", g);
+
+        // Merge the sources and keep the newest page
+        std::sort(result.begin(), result.end(), [](const ChatMessage& a, const ChatMessage& b)
+                  { return a.id > b.id; });
+        result.erase(std::unique(result.begin(), result.end(),
+                                 [](const ChatMessage& a, const ChatMessage& b)
+                                 { return a.id == b.id; }),
+                     result.end());
+        if (result.size() > static_cast<std::size_t>(limit))
+            result.resize(static_cast<std::size_t>(limit));
+        return result; });
+}
+
+// ── Users ───────────────────────────────────────────────────────────
+
+bool Database::insertUser(const std::string& username,
+                          const std::string& password_hash)
+{
+    static const char* kSql =
+        "INSERT OR IGNORE INTO users (username, password_hash) VALUES (?, ?);";
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writer_.db) return false;
+
+    sqlite3_stmt* stmt = writer_.prepare(kSql);
+    if (!stmt) return false;
+
+    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, password_hash.c_str(), -1, SQLITE_TRANSIENT);
+
+    bool ok = (sqlite3_step(stmt) == SQLITE_DONE) && (sqlite3_changes(writer_.db) > 0);
+    sqlite3_reset(stmt);
+    return ok;
+}
+
+bool Database::getUserPasswordHash(const std::string& username,
+                                   std::string& out_hash) const
+{
+    static const char* kSql = "SELECT password_hash FROM users WHERE username = ?;";
+
+    return withReader([&](DbHandle& h)
+                      {
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return false;
+
+        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+
+        bool found = false;
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            out_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            found = true;
+        }
+        sqlite3_reset(stmt);
+        return found; });
+}
+
+bool Database::updateUserPasswordHash(const std::string& username,
+                                      const std::string& password_hash)
+{
+    static const char* kSql = "UPDATE users SET password_hash = ? WHERE username = ?;";
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writer_.db) return false;
+
+    sqlite3_stmt* stmt = writer_.prepare(kSql);
+    if (!stmt) return false;
+
+    sqlite3_bind_text(stmt, 1, password_hash.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, username.c_str(), -1, SQLITE_TRANSIENT);
+
+    bool ok = (sqlite3_step(stmt) == SQLITE_DONE) && (sqlite3_changes(writer_.db) > 0);
+    sqlite3_reset(stmt);
+    return ok;
+}
+
+bool Database::userExists(const std::string& username) const
+{
+    std::string dummy;
+    return getUserPasswordHash(username, dummy);
+}
+
+// ── Groups ──────────────────────────────────────────────────────────
+
+std::int64_t Database::insertGroup(const std::string& name)
+{
+    static const char* kSql = "INSERT OR IGNORE INTO chat_groups (name) VALUES (?);";
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writer_.db) return 0;
+
+    sqlite3_stmt* stmt = writer_.prepare(kSql);
+    if (!stmt) return 0;
+
+    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+
+    bool ok = (sqlite3_step(stmt) == SQLITE_DONE) && (sqlite3_changes(writer_.db) > 0);
+    sqlite3_reset(stmt);
+    return ok ? sqlite3_last_insert_rowid(writer_.db) : 0;
+}
+
+bool Database::insertGroupMember(std::int64_t group_id, const std::string& username)
+{
+    static const char* kSql =
+        "INSERT OR IGNORE INTO group_members (group_id, username) VALUES (?, ?);";
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writer_.db) return false;
+
+    sqlite3_stmt* stmt = writer_.prepare(kSql);
+    if (!stmt) return false;
+
+    sqlite3_bind_int64(stmt, 1, group_id);
+    sqlite3_bind_text(stmt, 2, username.c_str(), -1, SQLITE_TRANSIENT);
+
+    bool ok = (sqlite3_step(stmt) == SQLITE_DONE) && (sqlite3_changes(writer_.db) > 0);
+    sqlite3_reset(stmt);
+    return ok;
+}
+
+std::vector<Database::GroupRecord> Database::loadGroups() const
+{
+    static const char* kSql =
+        "SELECT g.id, g.name, m.username FROM chat_groups g "
+        "LEFT JOIN group_members m ON m.group_id = g.id ORDER BY g.id;";
+
+    return withReader([&](DbHandle& h)
+                      {
+        std::vector<GroupRecord> groups;
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return groups;
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            std::int64_t id = sqlite3_column_int64(stmt, 0);
+            if (groups.empty() || groups.back().id != id)
+                groups.push_back({id, reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), {}});
+            if (sqlite3_column_type(stmt, 2) != SQLITE_NULL)
+                groups.back().members.emplace_back(
+                    reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+        }
+        sqlite3_reset(stmt);
+        return groups; });
+}
+
+// ── Offline delivery ────────────────────────────────────────────────
+
+int Database::committedOfflineDepth(const std::string& username) const
+{
+    static const char* kSql =
+        "SELECT EXISTS (SELECT 1 FROM users WHERE username = ?1),"
+        "       (SELECT COUNT(*) FROM offline_queue WHERE recipient = ?1);";
+
+    return withReader([&](DbHandle& h)
+                      {
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return -1;
+        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+        int depth = -1;
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0))
+            depth = sqlite3_column_int(stmt, 1);
+        sqlite3_reset(stmt);
+        return depth; });
+}
+
+Database::OfflineResult Database::queueOfflineMessage(const std::string& sender,
+                                                     const std::string& receiver,
+                                                     const std::string& content)
+{
+    std::size_t stripe = std::hash<std::string>{}(receiver) % offline_send_stripes_.size();
+    std::lock_guard<std::mutex> send_lock(offline_send_stripes_[stripe]);
+
+    // Unwritten first: rows only move from there to the table, so a commit
+    // in between is counted twice for a moment but never missed
+    std::size_t unwritten = 0;
+    {
+        std::lock_guard<std::mutex> lock(offline_mtx_);
+        auto it = offline_unwritten_.find(receiver);
+        if (it != offline_unwritten_.end()) unwritten = it->second.size();
+    }
+    int committed = committedOfflineDepth(receiver);
+    if (committed < 0) return OfflineResult::UnknownUser;
+    if (static_cast<std::size_t>(committed) + unwritten >= static_cast<std::size_t>(Config::OFFLINE_QUEUE_MAX))
+        return OfflineResult::QueueFull;
+
+    return enqueueMessage(sender, receiver, content, "private", true)
+               ? OfflineResult::Queued
+               : OfflineResult::Closed;
+}
+
+std::vector<ChatMessage> Database::offlineMessages(const std::string& username) const
+{
+    static const char* kSql =
+        "SELECT m.id, m.sender, m.receiver, m.content, m.type, m.timestamp "
+        "FROM offline_queue q JOIN messages m ON m.id = q.message_id "
+        "WHERE q.recipient = ? ORDER BY q.message_id;";
+
+    // Same order as the cap: a message committed after this snapshot is
+    // found by the query, and duplicates are dropped below
+    std::vector<ChatMessage> result;
+    {
+        std::lock_guard<std::mutex> lock(offline_mtx_);
+        auto it = offline_unwritten_.find(username);
+        if (it != offline_unwritten_.end()) result = it->second;
+    }
+
+    withReader([&](DbHandle& h)
+               {
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return;
+        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+        readMessages(stmt, result); });
+
+    std::sort(result.begin(), result.end(), [](const ChatMessage& a, const ChatMessage& b)
+              { return a.id < b.id; });
+    result.erase(std::unique(result.begin(), result.end(), [](const ChatMessage& a, const ChatMessage& b)
+                             { return a.id == b.id; }),
+                 result.end());
+    return result;
+}
+
+void Database::markOfflineDelivered(const std::string& username,
+                                    const std::vector<ChatMessage>& delivered)
+{
+    static const char* kBegin = "BEGIN;";
+    static const char* kCommit = "COMMIT;";
+    static const char* kDelete =
+        "DELETE FROM offline_queue WHERE recipient = ? AND message_id = ?;";
+
+    if (delivered.empty()) return;
+
+    // Not yet written: the writer skips their queue rows once they are gone
+    {
+        std::lock_guard<std::mutex> lock(offline_mtx_);
+        auto it = offline_unwritten_.find(username);
+        if (it != offline_unwritten_.end())
+        {
+            auto& waiting = it->second;
+            for (const auto& m : delivered)
+                waiting.erase(std::remove_if(waiting.begin(), waiting.end(), [&](const ChatMessage& w)
+                                             { return w.id == m.id; }),
+                              waiting.end());
+            if (waiting.empty()) offline_unwritten_.erase(it);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writer_.db) return;
+
+    sqlite3_stmt* begin = writer_.prepare(kBegin);
+    sqlite3_stmt* del = writer_.prepare(kDelete);
+    if (!begin || !del) return;
+
+    // Exact ids, not a range: a message sent during the login stays queued
+    if (sqlite3_step(begin) != SQLITE_DONE)
+    {
+        // Still queued, so the next login delivers them again
+        std::cerr << "[DB] Mark offline delivered: " << sqlite3_errmsg(writer_.db) << "\n";
+        return;
+    }
+    for (const auto& m : delivered)
+    {
+        sqlite3_reset(del);
+        sqlite3_bind_text(del, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(del, 2, m.id);
+        sqlite3_step(del);
+    }
+    sqlite3_reset(del);
+
+    sqlite3_stmt* commit = writer_.prepare(kCommit);
+    if (!commit || sqlite3_step(commit) != SQLITE_DONE)
+    {
+        std::cerr << "[DB] Mark offline delivered: " << sqlite3_errmsg(writer_.db) << "\n";
+        sqlite3_exec(writer_.db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+}
+
+// ── Maintenance ─────────────────────────────────────────────────────
+
+std::int64_t Database::retentionCutoff(std::int64_t min_timestamp_ms, std::size_t max_rows) const
+{
+    static const char* kOldestKept =
+        "SELECT id FROM messages ORDER BY id DESC LIMIT 1 OFFSET ?;";
+    static const char* kLastTooOld = "SELECT MAX(id) FROM messages WHERE timestamp < ?;";
+
+    return withReader([&](DbHandle& h) -> std::int64_t
+                      {
+        if (!h.db) return 1;
+        sqlite3_stmt* stmt = nullptr;
+        std::int64_t cutoff = 1;
+        if (max_rows > 0 && (stmt = h.prepare(kOldestKept)))
+        {
+            // Ids have gaps (failed batches, older prunes); no row means under the cap
+            sqlite3_bind_int64(stmt, 1, static_cast<std::int64_t>(max_rows) - 1);
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                cutoff = std::max<std::int64_t>(cutoff, sqlite3_column_int64(stmt, 0));
+            sqlite3_reset(stmt);
+        }
+
+        if (min_timestamp_ms > 0 && (stmt = h.prepare(kLastTooOld)))
+        {
+            // Pruning goes by id, so judge age by id too: after a clock step
+            // the two orders disagree, and newer ids below an expired one go with it.
+            // Range scan on idx_messages_timestamp over the expired rows only.
+            sqlite3_bind_int64(stmt, 1, min_timestamp_ms);
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+                cutoff = std::max<std::int64_t>(cutoff, sqlite3_column_int64(stmt, 0) + 1);
+            sqlite3_reset(stmt);
+        }
+        return cutoff; });
+}
+
+std::int64_t Database::pruneBatchEnd(std::int64_t before_id, std::size_t limit) const
+{
+    static const char* kSql =
+        "SELECT MAX(id) FROM (SELECT id FROM messages WHERE id < ? ORDER BY id LIMIT ?);";
+
+    return withReader([&](DbHandle& h) -> std::int64_t
+                      {
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return 0;
+        sqlite3_bind_int64(stmt, 1, before_id);
+        sqlite3_bind_int64(stmt, 2, static_cast<std::int64_t>(limit));
+        std::int64_t last = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+        sqlite3_reset(stmt);
+        return last; });
+}
+
+std::vector<ChatMessage> Database::messagesThrough(std::int64_t last_id) const
+{
+    static const char* kSql =
+        "SELECT id, sender, receiver, content, type, timestamp FROM messages "
+        "WHERE id <= ? ORDER BY id;";
+
+    return withReader([&](DbHandle& h)
+                      {
+        std::vector<ChatMessage> result;
+        sqlite3_stmt* stmt = h.db ? h.prepare(kSql) : nullptr;
+        if (!stmt) return result;
+        sqlite3_bind_int64(stmt, 1, last_id);
+        readMessages(stmt, result);
+        return result; });
+}
+
+std::size_t Database::deleteMessagesThrough(std::int64_t last_id)
+{
+    static const char* kBegin = "BEGIN IMMEDIATE;";
+    static const char* kCommit = "COMMIT;";
+    static const char* kRollback = "ROLLBACK;";
+    static const char* kSql = "DELETE FROM messages WHERE id <= ?;";
+    static const char* kOffline = "DELETE FROM offline_queue WHERE message_id <= ?;";
+
+    std::size_t deleted = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!writer_.db) return 0;
+
+        sqlite3_stmt* begin = writer_.prepare(kBegin);
+        sqlite3_stmt* stmt = writer_.prepare(kSql);
+        sqlite3_stmt* offline = writer_.prepare(kOffline);
+        if (!begin || !stmt || !offline) return 0;
+        if (sqlite3_step(begin) != SQLITE_DONE)
+        {
+            std::cerr << "[DB] Prune begin: " << sqlite3_errmsg(writer_.db) << "\n";
+            return 0;
+        }
+
+        bool ok = true;
+        sqlite3_bind_int64(stmt, 1, last_id);
+        if (sqlite3_step(stmt) == SQLITE_DONE)
+            deleted = static_cast<std::size_t>(sqlite3_changes(writer_.db));
+        else
+            ok = false;
+        sqlite3_reset(stmt);
+
+        // Queued messages that expired undelivered go with them
+        sqlite3_bind_int64(offline, 1, last_id);
+        if (ok && sqlite3_step(offline) != SQLITE_DONE) ok = false;
+        sqlite3_reset(offline);
+
+        sqlite3_stmt* commit = ok ? writer_.prepare(kCommit) : nullptr;
+        if (!commit || sqlite3_step(commit) != SQLITE_DONE)
+        {
+            std::cerr << "[DB] Prune messages: " << sqlite3_errmsg(writer_.db) << "\n";
+            if (sqlite3_stmt* rollback = writer_.prepare(kRollback))
+                sqlite3_step(rollback);
+            return 0;
+        }
+    }
+    history_cache_.discardThrough(last_id);
+    return deleted;
+}
+
+bool Database::checkpoint()
+{
+    std::lock_guard<std::mutex> lock(checkpointer_mtx_);
+    if (!checkpointer_.db) return false;
+
+    int frames = 0;
+    int copied = 0;
+    int rc = sqlite3_wal_checkpoint_v2(checkpointer_.db, nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                       &frames, &copied);
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+        std::cerr << "[DB] Checkpoint: " << sqlite3_errmsg(checkpointer_.db) << "\n";
+    return rc == SQLITE_OK && frames > 0 && copied == frames;
+}
+
+void Database::truncateWal()
+{
+    std::lock_guard<std::mutex> lock(checkpointer_mtx_);
+    if (!checkpointer_.db) return;
+
+    // No busy wait: with readers still on the WAL, give up now rather than
+    // hold the writer back until they finish
+    sqlite3_busy_timeout(checkpointer_.db, 0);
+    int rc = sqlite3_wal_checkpoint_v2(checkpointer_.db, nullptr, SQLITE_CHECKPOINT_TRUNCATE,
+                                       nullptr, nullptr);
+    sqlite3_busy_timeout(checkpointer_.db, kBusyTimeoutMs);
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+        std::cerr << "[DB] Truncate WAL: " << sqlite3_errmsg(checkpointer_.db) << "\n";
+}
+
+void Database::setWalAutoCheckpoint(int pages)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (writer_.db) sqlite3_wal_autocheckpoint(writer_.db, pages);
+}
+
+void Database::incrementalVacuum(int pages)
+{
+    std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(pages) + ");";
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writer_.db) return;
+
+    // The pragma frees one page per step; a no-op unless auto_vacuum=INCREMENTAL
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(writer_.db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+        return;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+    }
+    sqlite3_finalize(stmt);
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "../includes/HistoryCache.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+HistoryCache::HistoryCache(std::size_t capacity)
+    : capacity_(capacity), ring_(capacity) {}
+
+void HistoryCache::push(const ChatMessage& msg)
+{
+    if (capacity_ == 0) return;
+
+    std::unique_lock lock(mtx_);
+    ring_[next_] = msg; // reuses the slot's string capacity
+    next_ = (next_ + 1) % capacity_;
+    if (size_ < capacity_)
+        ++size_;
+    else
+        complete_ = false; // evicted a message the ring can no longer serve
+}
+
+void HistoryCache::warm(const std::vector<ChatMessage>& newest_first, bool complete)
+{
+    if (capacity_ == 0) return;
+
+    std::unique_lock lock(mtx_);
+    size_ = std::min(newest_first.size(), capacity_);
+    for (std::size_t i = 0; i < size_; ++i)
+        ring_[size_ - 1 - i] = newest_first[i];
+    next_ = size_ % capacity_;
+    complete_ = complete && newest_first.size() <= capacity_;
+}
+
+void HistoryCache::discardThrough(std::int64_t last_id)
+{
+    if (capacity_ == 0) return;
+
+    // Oldest first; complete_ still holds since what remains is all that exists
+    std::unique_lock lock(mtx_);
+    while (size_ > 0 && ring_[(next_ + capacity_ - size_) % capacity_].id <= last_id)
+        --size_;
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include "../includes/IoUring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    int sys_setup(unsigned entries, io_uring_params* p)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    int sys_register(int fd, unsigned op, void* arg, unsigned nr)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, op, arg, nr));
+    }
+
+    /// Operations the server submits; init() refuses kernels missing any of them.
+    const std::uint8_t kRequiredOps[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+                                         IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL};
+}
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+void IoUring::release()
+{
+    if (buf_ring_) munmap(buf_ring_, buf_ring_len_);
+    if (buffers_) munmap(buffers_, buffers_len_);
+    if (sqes_) munmap(sqes_, sqes_len_);
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_len_);
+    if (sq_ptr_) munmap(sq_ptr_, sq_len_);
+    if (fd_ >= 0) ::close(fd_);
+    buf_ring_ = nullptr;
+    buffers_ = nullptr;
+    sqes_ = nullptr;
+    cq_ptr_ = sq_ptr_ = nullptr;
+    fd_ = -1;
+}
+
+bool IoUring::init(unsigned entries, std::string& why)
+{
+    io_uring_params p{};
+    p.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    fd_ = sys_setup(entries, &p);
+    if (fd_ < 0 && errno == EINVAL)
+    {
+        p = io_uring_params{}; // older kernel: no optional setup flags
+        fd_ = sys_setup(entries, &p);
+    }
+    if (fd_ < 0)
+    {
+        why = std::string("io_uring_setup: ") + std::strerror(errno);
+        return false;
+    }
+
+    const unsigned kNeeded = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((p.features & kNeeded) != kNeeded)
+    {
+        why = "kernel lacks IORING_FEAT_EXT_ARG/NODROP";
+        release();
+        return false;
+    }
+
+    alignas(io_uring_probe) unsigned char probe_buf[sizeof(io_uring_probe) +
+                                                    256 * sizeof(io_uring_probe_op)] = {};
+    auto* probe = reinterpret_cast<io_uring_probe*>(probe_buf);
+    if (sys_register(fd_, IORING_REGISTER_PROBE, probe, 256) < 0)
+    {
+        why = std::string("IORING_REGISTER_PROBE: ") + std::strerror(errno);
+        release();
+        return false;
+    }
+    for (std::uint8_t op : kRequiredOps)
+    {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        {
+            why = "kernel lacks io_uring opcode " + std::to_string(op);
+            release();
+            return false;
+        }
+    }
+
+    // One mapping covers both rings (IORING_FEAT_SINGLE_MMAP)
+    sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+    sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED)
+    {
+        sq_ptr_ = nullptr;
+        why = std::string("mmap SQ ring: ") + std::strerror(errno);
+        release();
+        return false;
+    }
+    cq_ptr_ = sq_ptr_;
+
+    sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        why = std::string("mmap SQEs: ") + std::strerror(errno);
+        release();
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sq_entries_ = p.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+
+    auto* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::setupBufferRing(std::uint16_t group, unsigned count, unsigned size, std::string& why)
+{
+    buf_ring_len_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_len_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    buffers_len_ = std::size_t(count) * size;
+    void* bufs = mmap(nullptr, buffers_len_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED || bufs == MAP_FAILED)
+    {
+        if (ring != MAP_FAILED) munmap(ring, buf_ring_len_);
+        if (bufs != MAP_FAILED) munmap(bufs, buffers_len_);
+        why = std::string("mmap buffer ring: ") + std::strerror(errno);
+        return false;
+    }
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    buffers_ = static_cast<char*>(bufs);
+    buffer_size_ = size;
+    buf_mask_ = count - 1;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (sys_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        why = std::string("IORING_REGISTER_PBUF_RING: ") + std::strerror(errno);
+        return false;
+    }
+
+    buf_tail_ = 0;
+    for (unsigned i = 0; i < count; ++i)
+        recycleBuffer(static_cast<std::uint16_t>(i));
+    return true;
+}
+
+void IoUring::recycleBuffer(std::uint16_t bid)
+{
+    // Not buf_ring_->bufs: in C++ the header's flex-array wrapper shifts it by 8 bytes
+    io_uring_buf& b = reinterpret_cast<io_uring_buf*>(buf_ring_)[buf_tail_ & buf_mask_];
+    b.addr = reinterpret_cast<std::uint64_t>(buffers_ + std::size_t(bid) * buffer_size_);
+    b.len = buffer_size_;
+    b.bid = bid;
+    ++buf_tail_;
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+// ── Submission ──────────────────────────────────────────────────────
+
+io_uring_sqe* IoUring::nextSqe()
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head >= sq_entries_)
+    {
+        // Ring full: hand what we have to the kernel without waiting
+        enter(sq_local_tail_ - head, 0, 0, nullptr, 0);
+    }
+
+    unsigned idx = sq_local_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sq_local_tail_;
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+void IoUring::prepAcceptMultishot(int fd, std::uint64_t user_data)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepRecvMultishot(int fd, std::uint16_t group, std::uint64_t user_data)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepSendmsg(int fd, const msghdr* msg, unsigned flags, std::uint64_t user_data)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepPollMultishot(int fd, unsigned events, std::uint64_t user_data)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepCancel(std::uint64_t target, std::uint64_t user_data)
+{
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+int IoUring::enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg,
+                   std::size_t argsz)
+{
+    int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit, min_complete,
+                                       flags, arg, argsz));
+    return ret < 0 ? -errno : ret;
+}
+
+int IoUring::submitAndWait(int timeout_ms)
+{
+    unsigned to_submit = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+    __kernel_timespec ts{};
+    io_uring_getevents_arg arg{};
+    if (timeout_ms >= 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        arg.ts = reinterpret_cast<std::uint64_t>(&ts);
+    }
+
+    int ret = enter(to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret == -ETIME || ret == -EINTR) return 0;
+    return ret < 0 ? ret : 0;
+}
\ No newline at end of file
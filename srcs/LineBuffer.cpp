@@ -0,0 +1,90 @@
+#include "../includes/LineBuffer.hpp"
+
+#include <cstring>
+
+LineBuffer::LineBuffer(std::size_t max_line)
+    : max_line_(max_line) {}
+
+char* LineBuffer::writable(std::size_t min_space, std::size_t& avail)
+{
+    if (buf_.size() - tail_ < min_space && head_ > 0)
+    {
+        // Slide the partial line to the front instead of growing
+        std::size_t len = tail_ - head_;
+        std::memmove(buf_.data(), buf_.data() + head_, len);
+        scan_ -= head_;
+        head_ = 0;
+        tail_ = len;
+    }
+    if (buf_.size() - tail_ < min_space)
+        buf_.resize(tail_ + min_space);
+
+    avail = buf_.size() - tail_;
+    return buf_.data() + tail_;
+}
+
+void LineBuffer::commit(std::size_t n)
+{
+    tail_ += n;
+}
+
+bool LineBuffer::nextLine(std::string_view& line)
+{
+    while (true)
+    {
+        const char* base = buf_.data();
+        const void* nl = scan_ < tail_ ? std::memchr(base + scan_, '\n', tail_ - scan_) : nullptr;
+        if (!nl)
+        {
+            scan_ = tail_;
+            if (tail_ - head_ > max_line_)
+            {
+                // Too long to ever be a command: drop what we have and
+                // keep dropping until the line finally ends
+                if (!discarding_) overflow_ = true;
+                discarding_ = true;
+                head_ = scan_ = tail_;
+            }
+            if (head_ == tail_) head_ = scan_ = tail_ = 0;
+            return false;
+        }
+
+        std::size_t end = static_cast<const char*>(nl) - base;
+        std::size_t start = head_;
+        head_ = scan_ = end + 1;
+
+        if (discarding_)
+        {
+            discarding_ = false;
+            continue;
+        }
+        if (end - start > max_line_)
+        {
+            overflow_ = true;
+            continue;
+        }
+
+        if (end > start && base[end - 1] == '\r') --end;
+        line = std::string_view(base + start, end - start);
+        return true;
+    }
+}
+
+bool LineBuffer::takeOverflow()
+{
+    bool was = overflow_;
+    overflow_ = false;
+    return was;
+}
+
+std::string_view LineBuffer::peek() const
+{
+    return std::string_view(buf_.data() + head_, tail_ - head_);
+}
+
+void LineBuffer::consume(std::size_t n)
+{
+    head_ += n;
+    if (scan_ < head_) scan_ = head_;
+    if (head_ == tail_) head_ = scan_ = tail_ = 0;
+}
\ No newline at end of file
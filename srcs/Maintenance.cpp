@@ -0,0 +1,199 @@
+#include "../includes/Maintenance.hpp"
+#include "../includes/Metrics.hpp"
+#include "../includes/Utils.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace
+{
+    constexpr std::int64_t kDayMs = 24LL * 60 * 60 * 1000;
+    constexpr int kAutoCheckpointPages = 1000; ///< SQLite's default, restored on stop()
+    constexpr int kBatchPauseMs = 5;           ///< Gap between prune batches for the writer
+
+    /// @brief Append @p field to @p line with tab, CR, LF and backslash escaped.
+    void appendEscaped(std::string& line, const std::string& field)
+    {
+        for (char c : field)
+        {
+            switch (c)
+            {
+            case '\t': line += "\\t"; break;
+            case '\n': line += "\\n"; break;
+            case '\r': line += "\\r"; break;
+            case '\\': line += "\\\\"; break;
+            default: line.push_back(c);
+            }
+        }
+    }
+
+    /// @brief "<dir>/messages-YYYY-MM-DD.tsv.gz" for the UTC day @p day.
+    std::string segmentPath(const std::string& dir, std::int64_t day)
+    {
+        std::time_t start = static_cast<std::time_t>(day * (kDayMs / 1000));
+        std::tm utc{};
+        char date[sizeof("YYYY-MM-DD")] = "unknown";
+        if (gmtime_r(&start, &utc)) std::strftime(date, sizeof(date), "%F", &utc);
+        return dir + "/messages-" + date + ".tsv.gz";
+    }
+}
+
+Maintenance::Maintenance(Database& db, int retention_days, std::size_t max_rows,
+                         std::string archive_dir)
+    : db_(db), max_age_ms_(static_cast<std::int64_t>(retention_days) * kDayMs),
+      max_rows_(max_rows), archive_dir_(std::move(archive_dir)) {}
+
+Maintenance::~Maintenance()
+{
+    stop();
+}
+
+void Maintenance::start()
+{
+    if (thread_.joinable()) return;
+
+    if (!archive_dir_.empty() && ::mkdir(archive_dir_.c_str(), 0755) == -1 && errno != EEXIST)
+        perror("archive mkdir"); // archive() fails later and rows are kept
+
+    db_.setWalAutoCheckpoint(0); // checkpoints are ours from here on
+    stop_.store(false);
+    thread_ = std::thread(&Maintenance::run, this);
+
+    if (max_age_ms_ > 0 || max_rows_ > 0)
+        std::cout << "[Maintenance] Retention: "
+                  << (max_age_ms_ > 0 ? std::to_string(max_age_ms_ / kDayMs) + " day(s)" : "any age")
+                  << ", " << (max_rows_ > 0 ? std::to_string(max_rows_) + " row(s)" : "any count")
+                  << (archive_dir_.empty() ? "" : ", archived to " + archive_dir_) << "\n";
+}
+
+void Maintenance::stop()
+{
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_.store(true);
+    }
+    cv_.notify_all();
+    thread_.join();
+    db_.setWalAutoCheckpoint(kAutoCheckpointPages);
+}
+
+void Maintenance::run()
+{
+    const bool retention = max_age_ms_ > 0 || max_rows_ > 0;
+    std::int64_t next_prune = monotonic_ms(); // first pass right away
+    std::int64_t next_truncate = monotonic_ms() + Config::WAL_TRUNCATE_INTERVAL_MS;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_.load())
+    {
+        lock.unlock();
+        if (retention && monotonic_ms() >= next_prune)
+        {
+            if (!prune()) break;
+            next_prune = monotonic_ms() + Config::RETENTION_INTERVAL_MS;
+        }
+        // Passive checkpoints never shrink the WAL; once one has caught up, truncate it now and then
+        if (db_.checkpoint() && monotonic_ms() >= next_truncate)
+        {
+            db_.truncateWal();
+            next_truncate = monotonic_ms() + Config::WAL_TRUNCATE_INTERVAL_MS;
+        }
+        db_.incrementalVacuum(Config::VACUUM_PAGES);
+        lock.lock();
+
+        cv_.wait_for(lock, std::chrono::milliseconds(Config::MAINTENANCE_INTERVAL_MS), [this]
+                     { return stop_.load(); });
+    }
+}
+
+bool Maintenance::prune()
+{
+    std::int64_t min_ts = max_age_ms_ > 0 ? epoch_ms_coarse() - max_age_ms_ : 0;
+    std::int64_t cutoff = db_.retentionCutoff(min_ts, max_rows_);
+
+    std::size_t pruned = 0;
+    while (!stop_.load())
+    {
+        std::int64_t last = db_.pruneBatchEnd(cutoff, Config::RETENTION_BATCH);
+        if (last == 0) break;
+
+        if (!archive_dir_.empty() && !archive(db_.messagesThrough(last)))
+        {
+            std::cerr << "[Maintenance] Archive failed, keeping rows from id " << last << " down\n";
+            break;
+        }
+
+        std::size_t deleted = db_.deleteMessagesThrough(last);
+        if (deleted == 0) break;
+        pruned += deleted;
+        Metrics::add(Metrics::Counter::DbRowsPruned, deleted);
+
+        // Let queued message batches in before taking the write lock again
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, std::chrono::milliseconds(kBatchPauseMs), [this]
+                     { return stop_.load(); });
+    }
+
+    if (pruned > 0)
+        std::cout << "[Maintenance] Pruned " << pruned << " message(s) below id " << cutoff << "\n";
+    return !stop_.load();
+}
+
+bool Maintenance::archive(const std::vector<ChatMessage>& batch)
+{
+    gzFile out = nullptr;
+    std::int64_t open_day = 0;
+    std::string line;
+
+    auto close_segment = [&]
+    {
+        bool ok = !out || gzclose(out) == Z_OK;
+        out = nullptr;
+        return ok;
+    };
+
+    for (const auto& m : batch)
+    {
+        std::int64_t day = m.timestamp_ms >= 0 ? m.timestamp_ms / kDayMs : 0;
+        if (!out || day != open_day)
+        {
+            // Each open appends a new gzip member; zcat reads them as one stream
+            if (!close_segment()) return false;
+            std::string path = segmentPath(archive_dir_, day);
+            out = gzopen(path.c_str(), "ab");
+            if (!out)
+            {
+                perror(path.c_str());
+                return false;
+            }
+            open_day = day;
+        }
+
+        line.clear();
+        line += std::to_string(m.id);
+        line += '\t';
+        line += std::to_string(m.timestamp_ms);
+        line += '\t';
+        appendEscaped(line, m.type);
+        line += '\t';
+        appendEscaped(line, m.sender);
+        line += '\t';
+        appendEscaped(line, m.receiver);
+        line += '\t';
+        appendEscaped(line, m.content);
+        line += '\n';
+
+        if (gzwrite(out, line.data(), static_cast<unsigned>(line.size())) != static_cast<int>(line.size()))
+        {
+            close_segment();
+            return false;
+        }
+    }
+    return close_segment();
+}
\ No newline at end of file
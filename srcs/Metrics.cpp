@@ -0,0 +1,229 @@
+#include "../includes/Metrics.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace Metrics
+{
+    namespace
+    {
+        std::mutex g_registry_mtx;
+        std::vector<std::unique_ptr<Shard>> g_shards; ///< Never shrinks: shards outlive their threads
+
+        struct CounterInfo
+        {
+            const char* name;
+            const char* help;
+        };
+
+        const CounterInfo kCounterInfo[kCounters] = {
+            {"connections_accepted_total", "Client connections accepted"},
+            {"connections_closed_total", "Client connections closed"},
+            {"bytes_in_total", "Bytes received from clients"},
+            {"bytes_out_total", "Bytes written to clients"},
+            {"overload_events_total", "Times the task queue passed the high-water mark"},
+            {"shed_connections_total", "Connections refused while overloaded"},
+            {"shed_commands_total", "Low-priority commands refused while overloaded"},
+            {"db_rows_written_total", "Messages committed by the write-behind thread"},
+            {"db_rows_pruned_total", "Messages deleted by the retention policy"},
+            {"auth_rejected_total", "Logins and registrations refused while the auth queue was full"},
+            {"offline_queued_total", "Private messages stored for an offline recipient"},
+            {"offline_delivered_total", "Stored private messages delivered at login"},
+        };
+
+        struct LatencyInfo
+        {
+            const char* family; ///< Prometheus metric family
+            const char* label;  ///< command="..." (nullptr for unlabelled families)
+            const char* name;   ///< Row name on the /stats page
+            const char* help;   ///< HELP text, read from the first row of each family
+        };
+
+        constexpr const char* kCommandHelp = "Time spent running one client command";
+
+        const LatencyInfo kLatencyInfo[kLatencies] = {
+            {"command_latency_seconds", "broadcast", "broadcast", kCommandHelp},
+            {"command_latency_seconds", "to", "to", kCommandHelp},
+            {"command_latency_seconds", "group", "group", kCommandHelp},
+            {"command_latency_seconds", "history", "history", kCommandHelp},
+            {"command_latency_seconds", "login", "login", kCommandHelp},
+            {"command_latency_seconds", "reg", "reg", kCommandHelp},
+            {"command_latency_seconds", "create", "create", kCommandHelp},
+            {"command_latency_seconds", "join", "join", kCommandHelp},
+            {"command_latency_seconds", "quit", "quit", kCommandHelp},
+            {"command_latency_seconds", "stats", "stats", kCommandHelp},
+            {"db_commit_latency_seconds", nullptr, "db_commit", "Time to commit one write-behind batch"},
+            {"auth_queue_wait_seconds", nullptr, "auth_wait", "Time a /reg or /login waited for the auth executor"},
+            {"auth_kdf_seconds", nullptr, "auth_kdf", "Time spent in one password hash or verification"},
+        };
+
+        /// Exported `le` bounds in nanoseconds; buckets are folded into these.
+        const std::uint64_t kExportBoundsNs[] = {
+            1000, 5000, 10000, 50000, 100000, 500000,
+            1000000, 5000000, 10000000, 50000000, 100000000, 500000000,
+            1000000000, 5000000000ULL};
+
+        /// One histogram summed over every shard.
+        struct Merged
+        {
+            std::uint64_t count = 0;
+            std::uint64_t sum_ns = 0;
+            std::uint64_t buckets[kBuckets] = {};
+
+            /// Upper bound of the bucket holding quantile @p q.
+            std::uint64_t quantile(double q) const
+            {
+                if (count == 0) return 0;
+                auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+                std::uint64_t seen = 0;
+                for (std::size_t i = 0; i < kBuckets; ++i)
+                {
+                    seen += buckets[i];
+                    if (seen >= rank) return bucketUpperBound(i);
+                }
+                return bucketUpperBound(kBuckets - 1);
+            }
+        };
+
+        std::vector<Merged> mergeAll()
+        {
+            std::vector<Merged> out(kLatencies);
+            std::lock_guard<std::mutex> lock(g_registry_mtx);
+            for (const auto& shard : g_shards)
+            {
+                for (std::size_t l = 0; l < kLatencies; ++l)
+                {
+                    const Shard::Histogram& h = shard->histograms[l];
+                    out[l].count += h.count.load(std::memory_order_relaxed);
+                    out[l].sum_ns += h.sum_ns.load(std::memory_order_relaxed);
+                    for (std::size_t b = 0; b < kBuckets; ++b)
+                        out[l].buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+                }
+            }
+            return out;
+        }
+
+        std::string seconds(std::uint64_t ns)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.9g", static_cast<double>(ns) / 1e9);
+            return buf;
+        }
+
+        std::string micros(std::uint64_t ns)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.1fus", static_cast<double>(ns) / 1e3);
+            return buf;
+        }
+    }
+
+    Shard& registerShard()
+    {
+        auto shard = std::make_unique<Shard>(); // value-initialised: all zero
+        Shard* raw = shard.get();
+        {
+            std::lock_guard<std::mutex> lock(g_registry_mtx);
+            g_shards.push_back(std::move(shard));
+        }
+        t_shard = raw;
+        return *raw;
+    }
+
+    std::uint64_t bucketUpperBound(std::size_t i)
+    {
+        constexpr std::size_t kLinear = std::size_t{1} << kSubBits;
+        if (i < kLinear) return i;
+        unsigned e = static_cast<unsigned>(i >> kSubBits) + kSubBits - 1;
+        std::uint64_t sub = i & (kLinear - 1);
+        std::uint64_t width = std::uint64_t{1} << (e - kSubBits);
+        return ((kLinear + sub) << (e - kSubBits)) + width - 1;
+    }
+
+    std::uint64_t total(Counter c)
+    {
+        std::uint64_t sum = 0;
+        std::lock_guard<std::mutex> lock(g_registry_mtx);
+        for (const auto& shard : g_shards)
+            sum += shard->counters[static_cast<std::size_t>(c)].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    std::string renderText(const std::vector<Gauge>& gauges)
+    {
+        std::ostringstream oss;
+        oss << "=== Server Stats ===\r\n";
+        for (const Gauge& g : gauges)
+            oss << g.name << ": " << static_cast<std::uint64_t>(g.value) << "\r\n";
+        for (std::size_t c = 0; c < kCounters; ++c)
+            oss << kCounterInfo[c].name << ": " << total(static_cast<Counter>(c)) << "\r\n";
+
+        std::vector<Merged> merged = mergeAll();
+        for (std::size_t l = 0; l < kLatencies; ++l)
+        {
+            const Merged& m = merged[l];
+            if (m.count == 0) continue;
+            oss << kLatencyInfo[l].name
+                << ": n=" << m.count
+                << " avg=" << micros(m.sum_ns / m.count)
+                << " p50=" << micros(m.quantile(0.50))
+                << " p99=" << micros(m.quantile(0.99))
+                << " p999=" << micros(m.quantile(0.999)) << "\r\n";
+        }
+        return oss.str();
+    }
+
+    std::string renderPrometheus(const std::vector<Gauge>& gauges)
+    {
+        std::ostringstream oss;
+        for (const Gauge& g : gauges)
+        {
+            oss << "# HELP chatx_" << g.name << " " << g.help << "\n"
+                << "# TYPE chatx_" << g.name << (g.counter ? " counter\n" : " gauge\n")
+                << "chatx_" << g.name << " " << g.value << "\n";
+        }
+        for (std::size_t c = 0; c < kCounters; ++c)
+        {
+            const CounterInfo& info = kCounterInfo[c];
+            oss << "# HELP chatx_" << info.name << " " << info.help << "\n"
+                << "# TYPE chatx_" << info.name << " counter\n"
+                << "chatx_" << info.name << " " << total(static_cast<Counter>(c)) << "\n";
+        }
+
+        std::vector<Merged> merged = mergeAll();
+        const char* family = nullptr;
+        for (std::size_t l = 0; l < kLatencies; ++l)
+        {
+            const LatencyInfo& info = kLatencyInfo[l];
+            if (!family || std::string(family) != info.family)
+            {
+                family = info.family;
+                oss << "# HELP chatx_" << family << " " << info.help << "\n"
+                    << "# TYPE chatx_" << family << " histogram\n";
+            }
+
+            std::string labels = info.label ? std::string("command=\"") + info.label + "\"" : "";
+            std::string sep = labels.empty() ? "" : ",";
+            const Merged& m = merged[l];
+
+            // A bucket counts towards the first bound its upper edge fits under
+            std::uint64_t cumulative = 0;
+            std::size_t b = 0;
+            for (std::uint64_t bound : kExportBoundsNs)
+            {
+                for (; b < kBuckets && bucketUpperBound(b) <= bound; ++b)
+                    cumulative += m.buckets[b];
+                oss << "chatx_" << family << "_bucket{" << labels << sep
+                    << "le=\"" << seconds(bound) << "\"} " << cumulative << "\n";
+            }
+            oss << "chatx_" << family << "_bucket{" << labels << sep << "le=\"+Inf\"} "
+                << m.count << "\n";
+            std::string braces = labels.empty() ? "" : "{" + labels + "}";
+            oss << "chatx_" << family << "_sum" << braces << " " << seconds(m.sum_ns) << "\n"
+                << "chatx_" << family << "_count" << braces << " " << m.count << "\n";
+        }
+        return oss.str();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "../includes/MetricsEndpoint.hpp"
+#include "../includes/Utils.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr int kRequestWaitMs = 200;   ///< How long to wait for a request line
+    constexpr int kResponseWaitMs = 1000; ///< How long a scraper may take to read the response
+}
+
+MetricsEndpoint::MetricsEndpoint(std::string path, Render render)
+    : path_(std::move(path)), render_(std::move(render)) {}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    stop();
+}
+
+bool MetricsEndpoint::start()
+{
+    sockaddr_un addr{};
+    if (path_.empty() || path_.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "[Metrics] Invalid socket path \"" << path_ << "\"\n";
+        return false;
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ == -1)
+    {
+        perror("socket");
+        return false;
+    }
+
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path_.c_str(), path_.size() + 1);
+    ::unlink(path_.c_str()); // stale socket from a previous run
+
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 ||
+        listen(listen_fd_, 16) == -1)
+    {
+        perror("metrics bind");
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    thread_ = std::thread(&MetricsEndpoint::run, this);
+    std::cout << "[Metrics] Serving on unix:" << path_ << "\n";
+    return true;
+}
+
+void MetricsEndpoint::stop()
+{
+    if (thread_.joinable())
+    {
+        std::uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) perror("eventfd write");
+        thread_.join();
+    }
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+    if (listen_fd_ >= 0)
+    {
+        ::close(listen_fd_);
+        ::unlink(path_.c_str());
+    }
+    wake_fd_ = listen_fd_ = -1;
+}
+
+void MetricsEndpoint::run()
+{
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    while (true)
+    {
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return;
+        }
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int cfd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (cfd == -1)
+        {
+            if (errno != EINTR && errno != EAGAIN) perror("accept");
+            continue;
+        }
+        serve(cfd);
+        ::close(cfd);
+    }
+}
+
+void MetricsEndpoint::serve(int fd)
+{
+    // Read until the end of an HTTP header, EOF, or a short timeout
+    std::string request;
+    char buf[1024];
+    pollfd p{fd, POLLIN, 0};
+    while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos &&
+           poll(&p, 1, kRequestWaitMs) == 1)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        request.append(buf, static_cast<std::size_t>(n));
+    }
+
+    std::string body = render_();
+    if (request.compare(0, 3, "GET") == 0)
+    {
+        std::string head = "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " +
+                           std::to_string(body.size()) + "\r\n\r\n";
+        body.insert(0, head);
+    }
+    if (sendBounded(fd, body))
+        ::shutdown(fd, SHUT_WR);
+}
+
+bool MetricsEndpoint::sendBounded(int fd, const std::string& data)
+{
+    const std::int64_t deadline = monotonic_ms() + kResponseWaitMs;
+    std::size_t sent = 0;
+    while (true)
+    {
+        ssize_t n = send_nonblocking(fd, data.data() + sent, data.size() - sent);
+        if (n < 0) return false; // scraper went away
+        sent += static_cast<std::size_t>(n);
+        if (sent == data.size()) return true;
+
+        // Full socket: wait for room, the deadline, or stop()
+        std::int64_t left = deadline - monotonic_ms();
+        pollfd fds[2] = {{fd, POLLOUT, 0}, {wake_fd_, POLLIN, 0}};
+        if (left <= 0 || (poll(fds, 2, static_cast<int>(left)) == -1 && errno != EINTR) ||
+            fds[1].revents)
+        {
+            std::cerr << "[Metrics] Dropping a scraper that is not reading\n";
+            return false;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "../includes/Protocol.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    void put16(char* p, std::uint16_t v)
+    {
+        p[0] = static_cast<char>(v >> 8);
+        p[1] = static_cast<char>(v);
+    }
+
+    void put32(char* p, std::uint32_t v)
+    {
+        p[0] = static_cast<char>(v >> 24);
+        p[1] = static_cast<char>(v >> 16);
+        p[2] = static_cast<char>(v >> 8);
+        p[3] = static_cast<char>(v);
+    }
+
+    std::uint16_t get16(const char* p)
+    {
+        const auto* u = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<std::uint16_t>((u[0] << 8) | u[1]);
+    }
+
+    std::uint32_t get32(const char* p)
+    {
+        const auto* u = reinterpret_cast<const unsigned char*>(p);
+        return (std::uint32_t(u[0]) << 24) | (std::uint32_t(u[1]) << 16) |
+               (std::uint32_t(u[2]) << 8) | std::uint32_t(u[3]);
+    }
+}
+
+namespace Protocol
+{
+    Hello parseHello(std::string_view data)
+    {
+        std::size_t n = std::min(data.size(), sizeof(MAGIC));
+        if (std::memcmp(data.data(), MAGIC, n) != 0) return Hello::Text;
+        if (data.size() < HELLO_SIZE) return Hello::NeedMore;
+        return static_cast<std::uint8_t>(data[4]) == VERSION ? Hello::Accepted : Hello::Rejected;
+    }
+
+    std::string makeAck(std::uint8_t status)
+    {
+        std::string ack(HELLO_SIZE, '\0');
+        std::memcpy(ack.data(), MAGIC, sizeof(MAGIC));
+        ack[4] = static_cast<char>(VERSION);
+        ack[5] = static_cast<char>(status);
+        return ack;
+    }
+
+    FrameHeader decodeHeader(const char* p)
+    {
+        FrameHeader h;
+        h.length = get32(p);
+        h.opcode = static_cast<Opcode>(get16(p + 4));
+        h.flags = get16(p + 6);
+        h.request_id = get32(p + 8);
+        return h;
+    }
+
+    std::shared_ptr<const std::string> encodeFrame(Opcode op, std::uint32_t request_id,
+                                                   std::string_view payload)
+    {
+        if (payload.size() >= 2 && payload.substr(payload.size() - 2) == "\r\n")
+            payload.remove_suffix(2);
+
+        auto frame = std::make_shared<std::string>(HEADER_SIZE + payload.size(), '\0');
+        char* p = frame->data();
+        put32(p, static_cast<std::uint32_t>(payload.size()));
+        put16(p + 4, static_cast<std::uint16_t>(op));
+        put16(p + 6, 0);
+        put32(p + 8, request_id);
+        std::memcpy(p + HEADER_SIZE, payload.data(), payload.size());
+        return frame;
+    }
+}
\ No newline at end of file
@@ -1,501 +1,1861 @@
-#include "../includes/Server.hpp"
-#include "../includes/Config.hpp"
-#include "../includes/Utils.hpp"
-
-#include <arpa/inet.h>
-#include <cerrno>
-#include <cstring>
-#include <iostream>
-#include <netinet/in.h>
-#include <signal.h>
-#include <sstream>
-#include <sys/epoll.h>
-#include <sys/socket.h>
-#include <unistd.h>
-
-// ── Static members ──────────────────────────────────────────────────
-
-std::atomic<bool> Server::quit{false};
-
-// ── Lifecycle ───────────────────────────────────────────────────────
-
-Server::Server()
-    : userManager_(db_),
-      threadPool_(Config::THREAD_POOL_SIZE)
-{
-    std::cout << "[Server] Initialised\n";
-}
-
-Server::~Server()
-{
-    if (epoll_fd_ >= 0) ::close(epoll_fd_);
-    if (listen_fd_ >= 0) ::close(listen_fd_);
-    std::cout << "[Server] Shut down\n";
-}
-
-void Server::run_server()
-{
-    // Open database once at startup
-    if (!db_.open(Config::DB_FILENAME))
-    {
-        std::cerr << "[Server] Failed to open database, aborting.\n";
-        return;
-    }
-
-    create_and_bind();
-    setup_epoll();
-    run_event_loop();
-
-    db_.close();
-}
-
-// ── Socket setup ────────────────────────────────────────────────────
-
-void Server::create_and_bind()
-{
-    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd_ == -1)
-    {
-        perror("socket");
-        exit(EXIT_FAILURE);
-    }
-
-    // Allow immediate port reuse after restart
-    int opt = 1;
-    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(Config::SERVER_PORT);
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1)
-    {
-        perror("bind");
-        exit(EXIT_FAILURE);
-    }
-
-    if (listen(listen_fd_, Config::LISTEN_BACKLOG) == -1)
-    {
-        perror("listen");
-        exit(EXIT_FAILURE);
-    }
-
-    set_nonblocking(listen_fd_);
-    std::cout << "[Server] Listening on port " << Config::SERVER_PORT << "\n";
-}
-
-void Server::setup_epoll()
-{
-    epoll_fd_ = epoll_create1(0);
-    if (epoll_fd_ == -1)
-    {
-        perror("epoll_create1");
-        exit(EXIT_FAILURE);
-    }
-
-    epoll_event ev{};
-    ev.events = EPOLLIN;
-    ev.data.fd = listen_fd_;
-    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev) == -1)
-    {
-        perror("epoll_ctl");
-        exit(EXIT_FAILURE);
-    }
-}
-
-// ── Event loop ──────────────────────────────────────────────────────
-
-void Server::run_event_loop()
-{
-    epoll_event events[Config::MAX_EPOLL_EVENTS];
-    std::cout << "[Server] Entering event loop...\n";
-
-    while (!quit.load(std::memory_order_relaxed))
-    {
-        int n = epoll_wait(epoll_fd_, events, Config::MAX_EPOLL_EVENTS, 1000);
-        if (n == -1)
-        {
-            if (errno == EINTR) continue; // interrupted by signal
-            perror("epoll_wait");
-            continue;
-        }
-
-        for (int i = 0; i < n; ++i)
-        {
-            int fd = events[i].data.fd;
-            uint32_t ev = events[i].events;
-
-            if (fd == listen_fd_)
-            {
-                handle_new_connection();
-            }
-            else if (ev & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
-            {
-                handle_client_disconnection(fd);
-            }
-            else if (ev & EPOLLIN)
-            {
-                threadPool_.enqueue([this, fd]
-                                    { handle_client_input(fd); });
-            }
-        }
-    }
-
-    std::cout << "[Server] Event loop exited.\n";
-}
-
-// ── Connection management ───────────────────────────────────────────
-
-void Server::handle_new_connection()
-{
-    while (true)
-    {
-        sockaddr_in cliaddr{};
-        socklen_t len = sizeof(cliaddr);
-        int cfd = accept(listen_fd_, reinterpret_cast<sockaddr*>(&cliaddr), &len);
-
-        if (cfd == -1)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-            perror("accept");
-            return;
-        }
-
-        set_nonblocking(cfd);
-        userManager_.addClient(cfd);
-
-        epoll_event ev{};
-        ev.events = EPOLLIN | EPOLLRDHUP;
-        ev.data.fd = cfd;
-        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, cfd, &ev);
-
-        static const std::string kWelcome =
-            "Welcome to SimpleChatX!\r\n"
-            "Commands:\r\n"
-            "  /reg   <user> <pass>          Register\r\n"
-            "  /login <user> <pass>          Login\r\n"
-            "  /to    <user> <msg>           Private message\r\n"
-            "  /create <group>               Create group\r\n"
-            "  /join   <group>               Join group\r\n"
-            "  /group  <group> <msg>         Group message\r\n"
-            "  /history                      Recent messages\r\n"
-            "  /quit                         Disconnect\r\n";
-
-        safe_send(cfd, kWelcome);
-        std::cout << "[Server] Client connected: fd=" << cfd << "\n";
-    }
-}
-
-void Server::handle_client_disconnection(int fd)
-{
-    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
-    ::close(fd);
-    userManager_.logoutUser(fd);
-    userManager_.removeClient(fd);
-    std::cout << "[Server] Client disconnected: fd=" << fd << "\n";
-}
-
-// ── History helper ──────────────────────────────────────────────────
-
-std::string Server::formatHistory(const std::string& nickname, int fd, int limit)
-{
-    auto messages = db_.getRecentMessages(limit);
-
-    std::ostringstream oss;
-    oss << "=== Recent Messages ===\r\n";
-
-    for (const auto& m : messages)
-    {
-        bool visible = false;
-
-        if (m.type == "broadcast")
-            visible = true;
-        else if (m.type == "private")
-            visible = (m.sender == nickname || m.receiver == nickname);
-        else if (m.type == "group")
-            visible = userManager_.isInGroup(m.receiver, fd);
-
-        if (!visible) continue;
-
-        if (m.type == "broadcast")
-            oss << m.content << "\r\n";
-        else if (m.type == "private")
-            oss << "[Private] " << m.sender << " -> " << m.receiver << ": " << m.content << "\r\n";
-        else if (m.type == "group")
-            oss << "[Group " << m.receiver << "] " << m.sender << ": " << m.content << "\r\n";
-    }
-
-    std::string out = oss.str();
-    if (out == "=== Recent Messages ===\r\n")
-        out += "(no visible messages)\r\n";
-
-    return out;
-}
-
-// ── Input handling / command dispatch ────────────────────────────────
-
-void Server::handle_client_input(int fd)
-{
-    char buffer[Config::RECV_BUFFER_SIZE];
-
-    // Read until EAGAIN (drain all available data)
-    while (true)
-    {
-        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
-        if (n == 0)
-        {
-            handle_client_disconnection(fd);
-            return;
-        }
-        if (n < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-            perror("recv");
-            handle_client_disconnection(fd);
-            return;
-        }
-
-        if (!userManager_.hasClient(fd)) return;
-
-        // We need to work with the session buffer, but since getSession returns
-        // a copy for thread safety, we handle buffering at this level.
-        // Append received bytes — we'll process complete lines below.
-        // NOTE: For simplicity we store the read_buffer in the session via a
-        //       scoped helper that reads + writes back under the lock.
-        //       A production system would use per-fd buffers outside the shared map.
-        ClientSession session = userManager_.getSession(fd);
-        session.read_buffer += std::string(buffer, static_cast<std::size_t>(n));
-
-        std::size_t pos;
-        while ((pos = session.read_buffer.find('\n')) != std::string::npos)
-        {
-            std::string msg = session.read_buffer.substr(0, pos);
-            session.read_buffer.erase(0, pos + 1);
-
-            if (!msg.empty() && msg.back() == '\r') msg.pop_back();
-            if (msg.empty()) continue;
-
-            // ── /quit ───────────────────────────────────────────
-            if (msg == "/quit")
-            {
-                safe_send(fd, "Bye!\r\n");
-                handle_client_disconnection(fd);
-                return;
-            }
-
-            // ── Not logged in: only /reg and /login allowed ─────
-            if (!userManager_.isLoggedIn(fd))
-            {
-                if (msg.compare(0, 5, "/reg ") == 0)
-                {
-                    std::istringstream iss(msg.substr(5));
-                    std::string user, pass;
-                    iss >> user >> pass;
-
-                    if (user.empty() || pass.empty())
-                    {
-                        safe_send(fd, "Usage: /reg <username> <password>\r\n");
-                        break;
-                    }
-
-                    if (user.length() < Config::USERNAME_MIN_LEN ||
-                        user.length() > Config::USERNAME_MAX_LEN)
-                    {
-                        safe_send(fd, "Username must be 2-20 characters.\r\n");
-                        break;
-                    }
-
-                    if (pass.length() < Config::PASSWORD_MIN_LEN ||
-                        pass.length() > Config::PASSWORD_MAX_LEN)
-                    {
-                        safe_send(fd, "Password must be 6-20 characters.\r\n");
-                        break;
-                    }
-
-                    if (userManager_.registerUser(fd, user, pass))
-                        safe_send(fd, "Registered as [" + user + "]\r\n");
-                    else
-                        safe_send(fd, "Username already taken.\r\n");
-                }
-                else if (msg.compare(0, 7, "/login ") == 0)
-                {
-                    std::istringstream iss(msg.substr(7));
-                    std::string user, pass;
-                    iss >> user >> pass;
-
-                    if (user.empty() || pass.empty())
-                    {
-                        safe_send(fd, "Usage: /login <username> <password>\r\n");
-                        break;
-                    }
-
-                    if (user.length() < Config::USERNAME_MIN_LEN ||
-                        user.length() > Config::USERNAME_MAX_LEN)
-                    {
-                        safe_send(fd, "Username must be 2-20 characters.\r\n");
-                        break;
-                    }
-
-                    if (pass.length() < Config::PASSWORD_MIN_LEN ||
-                        pass.length() > Config::PASSWORD_MAX_LEN)
-                    {
-                        safe_send(fd, "Password must be 6-20 characters.\r\n");
-                        break;
-                    }
-
-                    if (userManager_.loginUser(fd, user, pass))
-                    {
-                        safe_send(fd, "Logged in as [" + user + "]\r\n");
-                        safe_send(fd, formatHistory(user, fd, Config::LOGIN_HISTORY));
-                    }
-                    else
-                    {
-                        safe_send(fd, "Login failed. Check username/password.\r\n");
-                    }
-                }
-                else
-                {
-                    safe_send(fd, "Please /reg or /login first.\r\n");
-                }
-                break; // process one command per recv-cycle for unauthenticated clients
-            }
-
-            // ── Authenticated commands ──────────────────────────
-
-            std::string nickname = userManager_.getNickname(fd);
-
-            // /history
-            if (msg == "/history")
-            {
-                safe_send(fd, formatHistory(nickname, fd, Config::DEFAULT_HISTORY));
-            }
-            // block duplicate auth
-            else if (msg.compare(0, 5, "/reg ") == 0 || msg.compare(0, 7, "/login ") == 0)
-            {
-                safe_send(fd, "Already logged in.\r\n");
-            }
-            // /to <user> <msg>
-            else if (msg.compare(0, 4, "/to ") == 0)
-            {
-                std::istringstream iss(msg.substr(4));
-                std::string target;
-                iss >> target;
-                std::string content;
-                std::getline(iss, content);
-                if (!content.empty() && content[0] == ' ') content.erase(0, 1);
-
-                if (target.empty() || content.empty())
-                {
-                    safe_send(fd, "Usage: /to <username> <message>\r\n");
-                }
-                else
-                {
-                    int tfd = userManager_.getFdByNickname(target);
-                    if (tfd == -1 || !userManager_.isLoggedIn(tfd))
-                    {
-                        safe_send(fd, "User [" + target + "] not online.\r\n");
-                    }
-                    else
-                    {
-                        safe_send(tfd, "[Private from " + nickname + "]: " + content + "\r\n");
-                        safe_send(fd, "[To " + target + "]: " + content + "\r\n");
-                        db_.insertMessage(nickname, target, content, "private");
-                    }
-                }
-            }
-            // /create <group>
-            else if (msg.compare(0, 8, "/create ") == 0)
-            {
-                std::string gname;
-                std::istringstream(msg.substr(8)) >> gname;
-
-                if (gname.empty())
-                    safe_send(fd, "Usage: /create <groupname>\r\n");
-                else if (userManager_.createGroup(gname))
-                {
-                    userManager_.joinGroup(gname, fd);
-                    safe_send(fd, "Group [" + gname + "] created & joined.\r\n");
-                }
-                else
-                    safe_send(fd, "Group [" + gname + "] already exists.\r\n");
-            }
-            // /join <group>
-            else if (msg.compare(0, 6, "/join ") == 0)
-            {
-                std::string gname;
-                std::istringstream(msg.substr(6)) >> gname;
-
-                if (gname.empty())
-                    safe_send(fd, "Usage: /join <groupname>\r\n");
-                else if (userManager_.joinGroup(gname, fd))
-                    safe_send(fd, "Joined [" + gname + "].\r\n");
-                else
-                    safe_send(fd, "Group [" + gname + "] not found or already joined.\r\n");
-            }
-            // /group <group> <msg>
-            else if (msg.compare(0, 7, "/group ") == 0)
-            {
-                std::istringstream iss(msg.substr(7));
-                std::string gname;
-                iss >> gname;
-                std::string content;
-                std::getline(iss, content);
-                if (!content.empty() && content[0] == ' ') content.erase(0, 1);
-
-                if (gname.empty() || content.empty())
-                {
-                    safe_send(fd, "Usage: /group <groupname> <message>\r\n");
-                }
-                else if (!userManager_.isInGroup(gname, fd))
-                {
-                    safe_send(fd, "Not in group [" + gname + "]. Use /join first.\r\n");
-                }
-                else
-                {
-                    std::string gmsg = "[Group " + gname + "] [" + nickname + "]: " + content + "\r\n";
-                    auto members = userManager_.getGroupMembers(gname);
-                    for (int mfd : members)
-                        if (mfd != fd) safe_send(mfd, gmsg);
-
-                    safe_send(fd, gmsg);
-                    db_.insertMessage(nickname, gname, content, "group");
-                }
-            }
-            // default: broadcast
-            else
-            {
-                std::string full = "[" + nickname + "]: " + msg + "\r\n";
-                broadcast_message(fd, full);
-            }
-        }
-
-        // If we broke out of the line-processing loop with remaining buffer,
-        // we'd normally write it back. For simplicity, any incomplete line is
-        // discarded here. A full implementation would write session.read_buffer
-        // back via a setter.
-        // TODO: persist leftover read_buffer back to session for partial-line support.
-        break; // one recv batch per call is sufficient with LT epoll
-    }
-}
-
-// ── Broadcast ───────────────────────────────────────────────────────
-
-void Server::broadcast_message(int from_fd, const std::string& msg)
-{
-    std::string nickname = userManager_.getNickname(from_fd);
-    db_.insertMessage(nickname, "ALL", msg, "broadcast");
-
-    // Take a snapshot of fds to avoid iterator invalidation
-    std::vector<int> fds = userManager_.getAllFds();
-    std::vector<int> failed;
-
-    for (int fd : fds)
-    {
-        if (!safe_send(fd, msg))
-            failed.push_back(fd);
-    }
-
-    for (int fd : failed)
-        handle_client_disconnection(fd);
+#include "../includes/Server.hpp"
+#include "../includes/Config.hpp"
+#include "../includes/Utils.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_set>
+
+// ── Static members ──────────────────────────────────────────────────
+
+std::atomic<bool> Server::quit{false};
+
+/// Id of the reactor running on this thread (-1 on workers).
+static thread_local int t_reactor_id = -1;
+
+namespace
+{
+    // io_uring user_data: small tags for reactor-wide operations, or a
+    // Connection pointer (8-byte aligned) with the operation in its low bits.
+    constexpr std::uint64_t kTagAccept = 1;
+    constexpr std::uint64_t kTagWake = 2;
+    constexpr std::uint64_t kTagCancel = 3;
+    constexpr std::uint64_t kOpRecv = 1;
+    constexpr std::uint64_t kOpSend = 2;
+    constexpr std::uint64_t kOpMask = 7;
+
+    constexpr std::uint16_t kBufferGroup = 0;                     ///< Provided-buffer group for recv
+    constexpr std::size_t kRxHighWater = Config::MAX_LINE_LENGTH; ///< Unframed bytes before recv pauses
+    constexpr std::size_t kMaxIov = 64;                           ///< Buffers gathered into one send
+
+    std::uint64_t op_tag(const Connection& conn, std::uint64_t op)
+    {
+        return reinterpret_cast<std::uint64_t>(&conn) | op;
+    }
+}
+
+// ── Lifecycle ───────────────────────────────────────────────────────
+
+Server::Server(const Settings& settings)
+    : settings_(settings),
+      maintenance_(db_, settings.retention_days, settings.retention_rows, settings.archive_dir),
+      userManager_(db_),
+      threadPool_(settings.reactor_threads > 0 ? 0 : settings.workerThreads(), settings.worker_cpus),
+      inline_dispatch_(settings.reactor_threads > 0),
+      use_uring_(settings.use_io_uring),
+      metrics_endpoint_(settings.metrics_socket_path, [this]
+                        { return Metrics::renderPrometheus(gauges()); }),
+      authPool_(settings.auth_threads)
+{
+    std::size_t n = std::max<std::size_t>(1, settings_.reactor_threads);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        reactors_.push_back(std::make_unique<Reactor>());
+        reactors_.back()->id = static_cast<int>(i);
+    }
+    std::cout << "[Server] Initialised: " << n << " reactor(s), " << threadPool_.size()
+              << " worker(s), " << authPool_.size() << " auth thread(s)\n";
+}
+
+Server::~Server()
+{
+    for (auto& r : reactors_)
+    {
+        if (r->wake_fd >= 0) ::close(r->wake_fd);
+        if (r->epoll_fd >= 0) ::close(r->epoll_fd);
+        if (r->listen_fd >= 0) ::close(r->listen_fd);
+    }
+    std::cout << "[Server] Shut down\n";
+}
+
+void Server::run_server()
+{
+    // Open database once at startup
+    if (!db_.open(settings_.db_filename))
+    {
+        std::cerr << "[Server] Failed to open database, aborting.\n";
+        return;
+    }
+    std::cout << "[Server] Loaded " << userManager_.loadGroups() << " group(s)\n";
+    maintenance_.start();
+
+    for (auto& r : reactors_)
+    {
+        create_and_bind(*r, inline_dispatch_);
+        if (use_uring_ && !setup_uring(*r))
+        {
+            if (r->id != 0) exit(EXIT_FAILURE); // reactors never mix backends
+            use_uring_ = false;
+        }
+        if (!use_uring_) setup_epoll(*r);
+    }
+    if (!settings_.metrics_socket_path.empty()) metrics_endpoint_.start(); // optional; logs its own failure
+
+    // Reactor 0 runs on the calling thread, the rest get their own
+    for (std::size_t i = 1; i < reactors_.size(); ++i)
+    {
+        Reactor& r = *reactors_[i];
+        r.thread = std::thread([this, &r]
+                               { run_event_loop(r); });
+    }
+    run_event_loop(*reactors_[0]);
+
+    for (std::size_t i = 1; i < reactors_.size(); ++i)
+    {
+        Reactor& r = *reactors_[i];
+        post(r, [] {}); // nudge out of epoll_wait
+        if (r.thread.joinable()) r.thread.join();
+    }
+
+    metrics_endpoint_.stop();
+    std::cout << "[Server] Load shedding: "
+              << Metrics::total(Metrics::Counter::OverloadEvents) << " overload episodes, "
+              << Metrics::total(Metrics::Counter::ShedConnections) << " connections and "
+              << Metrics::total(Metrics::Counter::ShedCommands) << " commands shed\n";
+
+    const HistoryCache& cache = db_.historyCache();
+    std::cout << "[Server] History cache: " << cache.hits() << " hits, "
+              << cache.misses() << " misses\n";
+
+    const CredentialCache& creds = userManager_.credentialCache();
+    std::cout << "[Server] Auth: " << creds.hits() << " cached logins, "
+              << Metrics::total(Metrics::Counter::AuthRejected) << " requests refused\n";
+    maintenance_.stop();
+    db_.close();
+}
+
+// ── Socket setup ────────────────────────────────────────────────────
+
+void Server::create_and_bind(Reactor& r, bool reuse_port)
+{
+    r.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (r.listen_fd == -1)
+    {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+
+    // Allow immediate port reuse after restart
+    int opt = 1;
+    setsockopt(r.listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // Set before listen(): accepted sockets inherit them, and the receive
+    // buffer size fixes the TCP window scale offered in the handshake
+    if (settings_.socket_rcvbuf > 0 &&
+        setsockopt(r.listen_fd, SOL_SOCKET, SO_RCVBUF, &settings_.socket_rcvbuf, sizeof(int)) == -1)
+        perror("setsockopt SO_RCVBUF");
+    if (settings_.socket_sndbuf > 0 &&
+        setsockopt(r.listen_fd, SOL_SOCKET, SO_SNDBUF, &settings_.socket_sndbuf, sizeof(int)) == -1)
+        perror("setsockopt SO_SNDBUF");
+
+    // Text clients have no ping: let the kernel find half-open peers, idle or not
+    if (Config::TCP_KEEPALIVE_IDLE_S > 0)
+    {
+        const int idle = Config::TCP_KEEPALIVE_IDLE_S;
+        const int interval = Config::TCP_KEEPALIVE_INTERVAL_S;
+        const int probes = Config::TCP_KEEPALIVE_PROBES;
+        if (setsockopt(r.listen_fd, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt)) == -1 ||
+            setsockopt(r.listen_fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) == -1 ||
+            setsockopt(r.listen_fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) == -1 ||
+            setsockopt(r.listen_fd, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes)) == -1)
+            perror("setsockopt keepalive");
+    }
+    if (Config::TCP_USER_TIMEOUT_MS > 0)
+    {
+        const unsigned timeout = Config::TCP_USER_TIMEOUT_MS;
+        if (setsockopt(r.listen_fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout)) == -1)
+            perror("setsockopt TCP_USER_TIMEOUT");
+    }
+
+    // Let every reactor bind its own listener; the kernel spreads accepts
+    if (reuse_port &&
+        setsockopt(r.listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1)
+    {
+        perror("setsockopt SO_REUSEPORT");
+        exit(EXIT_FAILURE);
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(settings_.port));
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(r.listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1)
+    {
+        perror("bind");
+        exit(EXIT_FAILURE);
+    }
+
+    if (listen(r.listen_fd, settings_.listen_backlog) == -1)
+    {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+
+    set_nonblocking(r.listen_fd);
+    std::cout << "[Server] Reactor " << r.id << " listening on port "
+              << settings_.port << "\n";
+}
+
+void Server::setup_epoll(Reactor& r)
+{
+    r.epoll_fd = epoll_create1(0);
+    if (r.epoll_fd == -1)
+    {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+
+    r.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r.wake_fd == -1)
+    {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = r.listen_fd;
+    if (epoll_ctl(r.epoll_fd, EPOLL_CTL_ADD, r.listen_fd, &ev) == -1)
+    {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+
+    ev.data.fd = r.wake_fd;
+    if (epoll_ctl(r.epoll_fd, EPOLL_CTL_ADD, r.wake_fd, &ev) == -1)
+    {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+bool Server::setup_uring(Reactor& r)
+{
+    std::string why;
+    auto ring = std::make_unique<IoUring>();
+    if (!ring->init(Config::URING_ENTRIES, why) ||
+        !ring->setupBufferRing(kBufferGroup, Config::URING_BUFFERS,
+                               static_cast<unsigned>(settings_.recv_buffer_size), why))
+    {
+        std::cout << "[Server] io_uring unavailable (" << why << "), falling back to epoll\n";
+        return false;
+    }
+
+    r.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r.wake_fd == -1)
+    {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
+    ring->prepAcceptMultishot(r.listen_fd, kTagAccept);
+    ring->prepPollMultishot(r.wake_fd, POLLIN, kTagWake);
+    r.ring = std::move(ring);
+    std::cout << "[Server] Reactor " << r.id << " using io_uring\n";
+    return true;
+}
+
+// ── Event loop ──────────────────────────────────────────────────────
+
+void Server::run_event_loop(Reactor& r)
+{
+    t_reactor_id = r.id;
+    if (!settings_.reactor_cpus.empty())
+    {
+        int cpu = settings_.reactor_cpus[static_cast<std::size_t>(r.id) % settings_.reactor_cpus.size()];
+        if (pin_current_thread(cpu))
+            std::cout << "[Server] Reactor " << r.id << " pinned to CPU " << cpu << "\n";
+        else
+            perror("pin reactor thread");
+    }
+    if (use_uring_)
+    {
+        run_uring_loop(r);
+        return;
+    }
+    std::vector<epoll_event> events(static_cast<std::size_t>(settings_.max_epoll_events));
+    std::cout << "[Server] Reactor " << r.id << " entering event loop...\n";
+
+    while (!quit.load(std::memory_order_relaxed))
+    {
+        int timeout = r.timers.waitMs(monotonic_ms(), Config::MAX_EPOLL_WAIT_MS);
+        int n = epoll_wait(r.epoll_fd, events.data(), settings_.max_epoll_events, timeout);
+        if (n == -1)
+        {
+            if (errno == EINTR) continue; // interrupted by signal
+            perror("epoll_wait");
+            continue;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+
+            if (fd == r.listen_fd)
+            {
+                handle_new_connection(r);
+            }
+            else if (fd == r.wake_fd)
+            {
+                drain_mailbox(r);
+            }
+            else
+            {
+                handle_client_event(r, fd, ev);
+            }
+        }
+
+        finish_pass(r);
+    }
+
+    std::cout << "[Server] Reactor " << r.id << " event loop exited.\n";
+}
+
+void Server::finish_pass(Reactor& r)
+{
+    // One wakeup pass for everything this iteration dispatched
+    if (!r.dispatch_batch.empty())
+    {
+        threadPool_.enqueue_batch(r.dispatch_batch);
+        check_overload();
+    }
+    if (!r.paused.empty() && !overloaded_.load(std::memory_order_relaxed))
+        resume_reads(r);
+    run_timers(r);
+}
+
+// ── Per-connection strands ──────────────────────────────────────────
+
+void Server::handle_client_event(Reactor& r, int fd, uint32_t ev)
+{
+    std::shared_ptr<Connection> conn = find_connection(fd);
+    if (!conn) return;
+
+    bool dispatch = false;
+    bool hangup = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        if (conn->closed.load()) return;
+        if (conn->armed_events & EPOLLONESHOT) conn->armed_events = 0; // the event disarmed the fd
+
+        if (ev & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            // A running strand sees the EOF/error itself and re-arms when
+            // it finishes; leave the fd disarmed until then.
+            if (conn->in_flight) return;
+            hangup = true;
+        }
+        else
+        {
+            if ((ev & EPOLLOUT) && !flush_output(*conn))
+                hangup = true;
+            else if ((ev & EPOLLIN) && !conn->in_flight && !conn->paused)
+            {
+                if (overloaded_.load(std::memory_order_relaxed))
+                {
+                    // Leave the bytes in the kernel; resume_reads() re-arms
+                    conn->paused = true;
+                    r.paused.push_back(conn);
+                }
+                else
+                {
+                    dispatch = conn->in_flight = true;
+                }
+            }
+            if (!hangup) update_interest(*conn);
+        }
+    }
+
+    if (hangup)
+        close_connection(conn);
+    else if (dispatch && inline_dispatch_)
+        run_strand(conn);
+    else if (dispatch)
+        r.dispatch_batch.emplace_back([this, conn]
+                                      { run_strand(conn); });
+}
+
+void Server::run_strand(const std::shared_ptr<Connection>& conn)
+{
+    while (true)
+    {
+        handle_client_input(*conn);
+
+        if (overloaded_.load(std::memory_order_relaxed) &&
+            threadPool_.depth() <= Config::TASK_QUEUE_LOW_WATER)
+        {
+            bool expected = true;
+            if (overloaded_.compare_exchange_strong(expected, false))
+            {
+                std::cout << "[Server] Load recovered: queue depth "
+                          << threadPool_.depth() << ", resuming reads\n";
+                post(*reactors_[0], [this]
+                     { resume_reads(*reactors_[0]); });
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(conn->io_mtx);
+        if (conn->auth_pending.load())
+        {
+            // resume_after_auth() restarts us; in_flight stays set until then
+            conn->auth_parked = true;
+            if (!use_uring_ && !conn->closed.load()) update_interest(*conn);
+            return;
+        }
+        if (conn->input_held && !conn->closed.load()) continue; // auth finished meanwhile
+
+        if (use_uring_)
+        {
+            // The reactor appended more while we ran: it left the work to us
+            if (!conn->closed.load() && !conn->rx_pending.empty()) continue;
+            conn->in_flight = false;
+            bool eof = conn->rx_eof && !conn->closed.load();
+            bool rearm = conn->rx_throttled && !eof;
+            bool reaped = conn->closed.load(); // close_connection() could not reap while we ran
+            conn->rx_throttled = false;
+            lock.unlock();
+            Reactor& owner = *reactors_[conn->reactor_id];
+            if (eof)
+                close_connection(conn);
+            else if (reaped)
+                post(owner, [this, &owner, conn]
+                     {
+                         std::lock_guard<std::mutex> lock(conn->io_mtx);
+                         reap(owner, conn); });
+            else if (rearm)
+                post(owner, [&owner, conn]
+                     { owner.recv_rearm.push_back(conn); });
+            return;
+        }
+
+        conn->in_flight = false;
+        if (conn->closed.load())
+            ::close(conn->fd); // close_connection() deferred this to us
+        else
+            update_interest(*conn);
+        return;
+    }
+}
+
+// ── Backpressure ────────────────────────────────────────────────────
+
+void Server::check_overload()
+{
+    std::size_t depth = threadPool_.depth();
+    if (depth < Config::TASK_QUEUE_HIGH_WATER || overloaded_.exchange(true)) return;
+
+    Metrics::add(Metrics::Counter::OverloadEvents);
+    std::cout << "[Server] Overloaded: queue depth " << depth << ", pausing reads\n";
+}
+
+void Server::resume_reads(Reactor& r)
+{
+    for (const auto& conn : r.paused)
+    {
+        bool dispatch = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->io_mtx);
+            conn->paused = false;
+            if (conn->closed.load()) continue;
+            if (!use_uring_)
+            {
+                update_interest(*conn);
+                continue;
+            }
+            // Bytes that arrived before the pause were never handed out
+            if (!conn->rx_pending.empty() && !conn->in_flight)
+                dispatch = conn->in_flight = true;
+        }
+        if (use_uring_ && !conn->recv_armed) r.recv_rearm.push_back(conn);
+        if (dispatch)
+            r.dispatch_batch.emplace_back([this, conn]
+                                          { run_strand(conn); });
+    }
+    r.paused.clear();
+}
+
+// ── Liveness ────────────────────────────────────────────────────────
+
+void Server::run_timers(Reactor& r)
+{
+    std::int64_t now = monotonic_ms();
+    r.timers.advance(now, r.due);
+    for (const auto& conn : r.due)
+        check_liveness(r, conn, now);
+    r.due.clear();
+}
+
+void Server::check_liveness(Reactor& r, const std::shared_ptr<Connection>& conn, std::int64_t now)
+{
+    if (conn->closed.load()) return;
+
+    std::int64_t last = conn->last_activity_ms.load(std::memory_order_relaxed);
+    bool paused;
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        paused = conn->paused;
+    }
+    if (paused)
+    {
+        // Its silence is ours: we stopped reading it
+        r.timers.schedule(conn, now + Config::TIMER_TICK_MS);
+        return;
+    }
+
+    const bool heartbeat = Config::HEARTBEAT_INTERVAL_MS > 0 &&
+                           conn->mode.load(std::memory_order_relaxed) == Protocol::WireMode::Binary;
+    if (heartbeat)
+    {
+        if (conn->ping_sent_ms != 0 && last >= conn->ping_sent_ms)
+            conn->ping_sent_ms = 0; // answered (any frame counts)
+
+        if (now - last >= Config::HEARTBEAT_INTERVAL_MS + Config::HEARTBEAT_TIMEOUT_MS)
+        {
+            std::cout << "[Server] Heartbeat timeout: fd=" << conn->fd << "\n";
+            close_connection(conn);
+        }
+        else if (now - last >= Config::HEARTBEAT_INTERVAL_MS)
+        {
+            if (conn->ping_sent_ms == 0)
+            {
+                conn->ping_sent_ms = now;
+                send_frame(conn->fd, Protocol::Opcode::Ping, 0, {});
+            }
+            r.timers.schedule(conn, last + Config::HEARTBEAT_INTERVAL_MS +
+                                        Config::HEARTBEAT_TIMEOUT_MS);
+        }
+        else
+        {
+            r.timers.schedule(conn, last + Config::HEARTBEAT_INTERVAL_MS);
+        }
+        return;
+    }
+
+    if (Config::IDLE_TIMEOUT_MS <= 0) return; // text clients never time out
+
+    if (now - last >= Config::IDLE_TIMEOUT_MS)
+    {
+        std::cout << "[Server] Closing idle connection fd=" << conn->fd << "\n";
+        send_to(conn->fd, "Idle timeout, disconnecting.\r\n");
+        close_connection(conn);
+    }
+    else
+    {
+        r.timers.schedule(conn, last + Config::IDLE_TIMEOUT_MS);
+    }
+}
+
+// ── Cross-reactor delivery ──────────────────────────────────────────
+
+void Server::post(Reactor& r, std::function<void()> task)
+{
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(r.mailbox_mtx);
+        was_empty = r.mailbox.empty();
+        r.mailbox.push_back(std::move(task));
+    }
+
+    // Only the first post since the last drain needs to wake the loop
+    if (was_empty)
+    {
+        uint64_t one = 1;
+        if (::write(r.wake_fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            perror("eventfd write");
+    }
+}
+
+void Server::drain_mailbox(Reactor& r)
+{
+    uint64_t count;
+    while (::read(r.wake_fd, &count, sizeof(count)) > 0) {}
+
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(r.mailbox_mtx);
+        tasks.swap(r.mailbox);
+    }
+    for (auto& task : tasks)
+        task();
+}
+
+std::shared_ptr<Connection> Server::find_connection(int fd) const
+{
+    std::shared_lock lock(conn_mtx_);
+    auto it = connections_.find(fd);
+    return (it != connections_.end()) ? it->second : nullptr;
+}
+
+std::vector<std::shared_ptr<Connection>> Server::collect_connections(const std::vector<int>& fds) const
+{
+    std::vector<std::shared_ptr<Connection>> out;
+    out.reserve(fds.size());
+
+    std::shared_lock lock(conn_mtx_);
+    for (int fd : fds)
+    {
+        auto it = connections_.find(fd);
+        if (it != connections_.end()) out.push_back(it->second);
+    }
+    return out;
+}
+
+namespace
+{
+    /// @brief The encoding of a fan-out payload that @p conn speaks.
+    const OutBuffer& pick_buffer(const Connection& conn, const OutBuffer& text,
+                                 const OutBuffer& frame)
+    {
+        return frame && conn.mode.load(std::memory_order_relaxed) == Protocol::WireMode::Binary
+                   ? frame
+                   : text;
+    }
+}
+
+bool Server::send_to(int fd, const std::string& msg)
+{
+    std::shared_ptr<Connection> conn = find_connection(fd);
+    if (!conn) return false;
+
+    if (conn->mode.load(std::memory_order_relaxed) == Protocol::WireMode::Binary)
+        return deliver(conn, Protocol::encodeFrame(Protocol::Opcode::Event, 0, msg));
+    return deliver(conn, std::make_shared<const std::string>(msg));
+}
+
+bool Server::send_frame(int fd, Protocol::Opcode op, std::uint32_t request_id,
+                        std::string_view payload)
+{
+    std::shared_ptr<Connection> conn = find_connection(fd);
+    if (!conn) return false;
+    return deliver(conn, Protocol::encodeFrame(op, request_id, payload));
+}
+
+bool Server::deliver(const std::shared_ptr<Connection>& conn, const OutBuffer& buf,
+                     std::function<void()> on_queued)
+{
+    if (!inline_dispatch_ || conn->reactor_id == t_reactor_id)
+    {
+        if (!queue_output(*conn, buf)) return false;
+        if (on_queued) on_queued();
+        return true;
+    }
+
+    // Owned by another reactor: let its loop do the write
+    post(*reactors_[conn->reactor_id], [this, conn, buf, on_queued = std::move(on_queued)]
+         {
+             if (conn->closed.load()) return;
+             if (!queue_output(*conn, buf))
+                 close_connection(conn);
+             else if (on_queued)
+                 on_queued(); });
+    return true;
+}
+
+void Server::fan_out(std::vector<std::shared_ptr<Connection>> targets, const OutBuffer& buf)
+{
+    // Binary clients get the same text wrapped once in an Event frame
+    OutBuffer frame;
+    for (const auto& conn : targets)
+        if (conn->mode.load(std::memory_order_relaxed) == Protocol::WireMode::Binary)
+        {
+            frame = Protocol::encodeFrame(Protocol::Opcode::Event, 0, *buf);
+            break;
+        }
+    std::vector<std::shared_ptr<Connection>> failed;
+    std::vector<std::vector<std::shared_ptr<Connection>>> remote;
+    if (inline_dispatch_) remote.resize(reactors_.size());
+
+    for (auto& conn : targets)
+    {
+        if (!inline_dispatch_ || conn->reactor_id == t_reactor_id)
+        {
+            if (!queue_output(*conn, pick_buffer(*conn, buf, frame))) failed.push_back(conn);
+        }
+        else
+        {
+            remote[conn->reactor_id].push_back(std::move(conn));
+        }
+    }
+
+    for (std::size_t i = 0; i < remote.size(); ++i)
+    {
+        if (remote[i].empty()) continue;
+        post(*reactors_[i], [this, conns = std::move(remote[i]), buf, frame]
+             {
+                 for (const auto& conn : conns)
+                     if (!conn->closed.load() && !queue_output(*conn, pick_buffer(*conn, buf, frame)))
+                         close_connection(conn); });
+    }
+
+    for (const auto& conn : failed)
+        close_connection(conn);
+}
+
+// ── Outbound queues ─────────────────────────────────────────────────
+
+bool Server::queue_output(Connection& conn, const OutBuffer& buf)
+{
+    std::lock_guard<std::mutex> lock(conn.io_mtx);
+    if (conn.closed.load()) return false;
+
+    if (use_uring_)
+    {
+        if (conn.out_bytes + buf->size() > Config::MAX_OUTBOUND_BYTES) return false;
+        if (conn.out_queue.empty()) conn.out_offset = 0;
+        conn.out_queue.push_back(buf);
+        conn.out_bytes += buf->size();
+        if (!conn.send_scheduled)
+        {
+            conn.send_scheduled = true;
+            schedule_send(conn);
+        }
+        return true;
+    }
+
+    std::size_t sent = 0;
+    if (conn.out_queue.empty())
+    {
+        ssize_t n = send_nonblocking(conn.fd, buf->data(), buf->size());
+        if (n < 0) return false;
+        sent = static_cast<std::size_t>(n);
+        Metrics::add(Metrics::Counter::BytesOut, sent);
+        if (sent == buf->size()) return true;
+    }
+
+    // Slow reader: cap what we are willing to hold for it
+    if (conn.out_bytes + (buf->size() - sent) > Config::MAX_OUTBOUND_BYTES)
+        return false;
+
+    if (conn.out_queue.empty()) conn.out_offset = sent;
+    conn.out_queue.push_back(buf);
+    conn.out_bytes += buf->size() - sent;
+    if (!conn.want_write)
+    {
+        conn.want_write = true;
+        update_interest(conn);
+    }
+    return true;
+}
+
+bool Server::flush_output(Connection& conn)
+{
+    while (!conn.out_queue.empty())
+    {
+        // Gather up to kMaxIov queued buffers into one writev
+        iovec iov[kMaxIov];
+        std::size_t cnt = 0;
+        std::size_t offset = conn.out_offset;
+        for (auto it = conn.out_queue.begin(); it != conn.out_queue.end() && cnt < kMaxIov; ++it)
+        {
+            iov[cnt].iov_base = const_cast<char*>((*it)->data() + offset);
+            iov[cnt].iov_len = (*it)->size() - offset;
+            offset = 0;
+            ++cnt;
+        }
+
+        ssize_t n = sendv_nonblocking(conn.fd, iov, static_cast<int>(cnt));
+        if (n < 0) return false;
+
+        consume_output(conn, static_cast<std::size_t>(n));
+        if (conn.out_bytes > 0 && static_cast<std::size_t>(n) == 0)
+            return true; // still full, wait for the next EPOLLOUT
+    }
+
+    if (conn.want_write)
+    {
+        conn.want_write = false;
+        update_interest(conn);
+    }
+    return true;
+}
+
+void Server::consume_output(Connection& conn, std::size_t written)
+{
+    Metrics::add(Metrics::Counter::BytesOut, written);
+    conn.out_bytes -= written;
+    while (written > 0)
+    {
+        std::size_t left = conn.out_queue.front()->size() - conn.out_offset;
+        if (written < left)
+        {
+            conn.out_offset += written;
+            break;
+        }
+        written -= left;
+        conn.out_queue.pop_front();
+        conn.out_offset = 0;
+    }
+}
+
+uint32_t Server::interest_mask(const Connection& conn) const
+{
+    // Parked for auth: keep input in the kernel, still flush output
+    if (conn.auth_parked)
+        return EPOLLONESHOT | (conn.want_write ? EPOLLOUT : 0u);
+    if (inline_dispatch_)
+        return EPOLLIN | EPOLLRDHUP | (conn.want_write ? EPOLLOUT : 0u);
+
+    // Pool mode: while a strand runs (or reads are paused), only output
+    // may wake the reactor, so no two workers ever read the same socket.
+    if (conn.in_flight || conn.paused)
+        return conn.want_write ? (EPOLLOUT | EPOLLONESHOT) : 0u;
+    return EPOLLIN | EPOLLRDHUP | EPOLLONESHOT | (conn.want_write ? EPOLLOUT : 0u);
+}
+
+void Server::update_interest(Connection& conn)
+{
+    uint32_t mask = interest_mask(conn);
+    if (mask == conn.armed_events) return;
+    conn.armed_events = mask;
+    if (mask == 0) return; // already disarmed by EPOLLONESHOT
+
+    epoll_event ev{};
+    ev.events = mask;
+    ev.data.fd = conn.fd;
+    epoll_ctl(reactors_[conn.reactor_id]->epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+}
+
+// ── Connection management ───────────────────────────────────────────
+
+void Server::handle_new_connection(Reactor& r)
+{
+    while (true)
+    {
+        sockaddr_in cliaddr{};
+        socklen_t len = sizeof(cliaddr);
+        int cfd = accept(r.listen_fd, reinterpret_cast<sockaddr*>(&cliaddr), &len);
+
+        if (cfd == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("accept");
+            return;
+        }
+
+        set_nonblocking(cfd);
+        register_client(r, cfd);
+    }
+}
+
+void Server::register_client(Reactor& r, int cfd)
+{
+    if (Config::SHED_CONNECTIONS && overloaded_.load(std::memory_order_relaxed))
+    {
+        // Accept-and-close tells the client now instead of letting it time out
+        static const char kBusy[] = "Server busy, please try again later.\r\n";
+        send_nonblocking(cfd, kBusy, sizeof(kBusy) - 1);
+        ::close(cfd);
+        Metrics::add(Metrics::Counter::ShedConnections);
+        return;
+    }
+    if (!userManager_.addClient(cfd))
+    {
+        std::cerr << "[Server] fd " << cfd << " exceeds the session table, rejecting\n";
+        ::close(cfd);
+        return;
+    }
+    auto conn = std::make_shared<Connection>(cfd, r.id);
+    {
+        std::unique_lock lock(conn_mtx_);
+        connections_[cfd] = conn;
+    }
+
+    if (use_uring_)
+    {
+        r.uring_conns.emplace(conn.get(), conn);
+        arm_recv(r, *conn);
+    }
+    else
+    {
+        epoll_event ev{};
+        ev.events = conn->armed_events = interest_mask(*conn);
+        ev.data.fd = cfd;
+        epoll_ctl(r.epoll_fd, EPOLL_CTL_ADD, cfd, &ev);
+    }
+
+    if (Config::IDLE_TIMEOUT_MS > 0 || Config::HEARTBEAT_INTERVAL_MS > 0)
+    {
+        // Negotiation may still pick binary; the first check re-evaluates
+        int first = Config::IDLE_TIMEOUT_MS > 0 ? Config::IDLE_TIMEOUT_MS
+                                                : Config::HEARTBEAT_INTERVAL_MS;
+        if (Config::HEARTBEAT_INTERVAL_MS > 0)
+            first = std::min(first, Config::HEARTBEAT_INTERVAL_MS);
+        r.timers.schedule(conn, conn->last_activity_ms.load() + first);
+    }
+
+    static const OutBuffer kWelcome = std::make_shared<const std::string>(
+        "Welcome to SimpleChatX!\r\n"
+        "Commands:\r\n"
+        "  /reg   <user> <pass>          Register\r\n"
+        "  /login <user> <pass>          Login\r\n"
+        "  /to    <user> <msg>           Private message\r\n"
+        "  /create <group>               Create group\r\n"
+        "  /join   <group>               Join group\r\n"
+        "  /group  <group> <msg>         Group message\r\n"
+        "  /history [before <id>] [n]    Recent messages\r\n"
+        "  /quit                         Disconnect\r\n");
+
+    queue_output(*conn, kWelcome);
+    Metrics::add(Metrics::Counter::ConnectionsAccepted);
+    std::cout << "[Server] Client connected: fd=" << cfd
+              << " reactor=" << r.id << "\n";
+}
+
+void Server::handle_client_disconnection(int fd)
+{
+    std::shared_ptr<Connection> conn = find_connection(fd);
+    if (conn) close_connection(conn);
+}
+
+void Server::close_connection(const std::shared_ptr<Connection>& conn)
+{
+    int fd = conn->fd;
+    {
+        std::unique_lock lock(conn_mtx_);
+        auto it = connections_.find(fd);
+        if (it == connections_.end() || it->second != conn) return; // already cleaned up
+        connections_.erase(it);
+    }
+
+    // Holding io_mtx waits out any in-progress write, and orders the
+    // in_flight check against run_strand() so exactly one side closes.
+    std::lock_guard<std::mutex> lock(conn->io_mtx);
+    if (conn->closed.exchange(true)) return;
+
+    userManager_.logoutUser(fd);
+    userManager_.removeClient(fd);
+    if (use_uring_)
+    {
+        // Last words (a reject ack, "Bye!") may not have been submitted yet
+        if (!conn->send_inflight) flush_output(*conn);
+        // Ends the pending recv/send; the owner closes the fd after their completions
+        ::shutdown(fd, SHUT_RDWR);
+        Reactor& owner = *reactors_[conn->reactor_id];
+        if (t_reactor_id == owner.id)
+            reap(owner, conn);
+        else
+            post(owner, [this, &owner, conn]
+                 {
+                     std::lock_guard<std::mutex> lock(conn->io_mtx);
+                     reap(owner, conn); });
+    }
+    else
+    {
+        epoll_ctl(reactors_[conn->reactor_id]->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        if (conn->in_flight)
+            ::shutdown(fd, SHUT_RDWR); // strand still reads this fd; it closes on exit
+        else
+            ::close(fd);
+    }
+    Metrics::add(Metrics::Counter::ConnectionsClosed);
+    std::cout << "[Server] Client disconnected: fd=" << fd << "\n";
+}
+
+// ── io_uring backend ────────────────────────────────────────────────
+
+void Server::run_uring_loop(Reactor& r)
+{
+    std::cout << "[Server] Reactor " << r.id << " entering event loop...\n";
+
+    while (!quit.load(std::memory_order_relaxed))
+    {
+        submit_sends(r);
+        int timeout = r.timers.waitMs(monotonic_ms(), Config::MAX_EPOLL_WAIT_MS);
+        int rc = r.ring->submitAndWait(timeout);
+        if (rc < 0 && rc != -EBUSY) // EBUSY: completions backed up, reap them first
+        {
+            errno = -rc;
+            perror("io_uring_enter");
+            continue;
+        }
+
+        r.ring->forEachCompletion([this, &r](const io_uring_cqe& cqe)
+                                  { handle_completion(r, cqe); });
+        finish_pass(r);
+    }
+
+    std::cout << "[Server] Reactor " << r.id << " event loop exited.\n";
+}
+
+void Server::handle_completion(Reactor& r, const io_uring_cqe& cqe)
+{
+    const bool more = cqe.flags & IORING_CQE_F_MORE;
+    switch (cqe.user_data)
+    {
+    case kTagAccept:
+        if (cqe.res >= 0)
+            register_client(r, cqe.res);
+        else if (cqe.res != -EAGAIN)
+        {
+            errno = -cqe.res;
+            perror("accept");
+        }
+        if (!more) r.ring->prepAcceptMultishot(r.listen_fd, kTagAccept);
+        return;
+    case kTagWake:
+        drain_mailbox(r);
+        if (!more) r.ring->prepPollMultishot(r.wake_fd, POLLIN, kTagWake);
+        return;
+    case kTagCancel:
+        return; // the cancelled recv reports itself
+    }
+
+    auto it = r.uring_conns.find(reinterpret_cast<Connection*>(cqe.user_data & ~kOpMask));
+    if (it == r.uring_conns.end()) return;
+    std::shared_ptr<Connection> conn = it->second; // reap() erases the entry
+
+    if ((cqe.user_data & kOpMask) == kOpRecv)
+        on_uring_recv(r, conn, cqe);
+    else
+        on_uring_send(r, conn, cqe);
+    if (conn->closed.load())
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        reap(r, conn);
+    }
+}
+
+void Server::on_uring_recv(Reactor& r, const std::shared_ptr<Connection>& conn,
+                           const io_uring_cqe& cqe)
+{
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+        conn->recv_armed = false;
+        r.recv_rearm.push_back(conn); // submit_sends() decides whether it still wants one
+    }
+
+    if (cqe.res == -ENOBUFS || cqe.res == -ECANCELED)
+        return; // out of provided buffers until this pass recycles them, or paused
+
+    if (cqe.res <= 0)
+    {
+        bool hangup = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->io_mtx);
+            if (conn->closed.load()) return;
+            // Let the strand finish what it has before closing
+            if (conn->in_flight || !conn->rx_pending.empty())
+                conn->rx_eof = true;
+            else
+                hangup = true;
+        }
+        if (cqe.res < 0)
+        {
+            errno = -cqe.res;
+            perror("recv");
+        }
+        if (hangup) close_connection(conn);
+        return;
+    }
+
+    std::uint16_t bid = IoUring::bufferId(cqe);
+    std::size_t n = static_cast<std::size_t>(cqe.res);
+    Metrics::add(Metrics::Counter::BytesIn, n);
+    conn->last_activity_ms.store(monotonic_ms(), std::memory_order_relaxed);
+
+    bool dispatch = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        if (!conn->closed.load())
+        {
+            conn->rx_pending.append(r.ring->buffer(bid), n);
+            bool cancel = false;
+            if (conn->in_flight)
+            {
+                // The strand picks this up before it finishes; stop reading if it lags far behind
+                if (conn->rx_pending.size() >= kRxHighWater && !conn->rx_throttled)
+                    cancel = conn->rx_throttled = true;
+            }
+            else if (!conn->paused)
+            {
+                if (overloaded_.load(std::memory_order_relaxed))
+                {
+                    // Keep the bytes; resume_reads() hands them out and re-arms
+                    cancel = conn->paused = true;
+                    r.paused.push_back(conn);
+                }
+                else
+                {
+                    dispatch = conn->in_flight = true;
+                }
+            }
+            if (cancel && conn->recv_armed)
+                r.ring->prepCancel(op_tag(*conn, kOpRecv), kTagCancel);
+        }
+    }
+    r.ring->recycleBuffer(bid);
+
+    if (dispatch && inline_dispatch_)
+        run_strand(conn);
+    else if (dispatch)
+        r.dispatch_batch.emplace_back([this, conn]
+                                      { run_strand(conn); });
+}
+
+void Server::on_uring_send(Reactor& r, const std::shared_ptr<Connection>& conn,
+                           const io_uring_cqe& cqe)
+{
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        conn->send_inflight = false;
+        if (!conn->closed.load() && cqe.res >= 0)
+        {
+            consume_output(*conn, static_cast<std::size_t>(cqe.res));
+            if (!conn->out_queue.empty())
+                r.send_ready.push_back(conn); // still scheduled: send the rest next pass
+            else
+                conn->send_scheduled = false;
+            return;
+        }
+        conn->send_scheduled = false;
+        if (conn->closed.load()) return;
+    }
+    close_connection(conn);
+}
+
+void Server::submit_sends(Reactor& r)
+{
+    for (const auto& conn : r.send_ready)
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        if (conn->closed.load() || conn->out_queue.empty())
+        {
+            conn->send_scheduled = false;
+            continue;
+        }
+
+        // Gather up to kMaxIov queued buffers into one SENDMSG
+        conn->send_iov.clear();
+        std::size_t offset = conn->out_offset;
+        for (auto it = conn->out_queue.begin();
+             it != conn->out_queue.end() && conn->send_iov.size() < kMaxIov; ++it)
+        {
+            conn->send_iov.push_back({const_cast<char*>((*it)->data() + offset),
+                                      (*it)->size() - offset});
+            offset = 0;
+        }
+        conn->send_msg = msghdr{};
+        conn->send_msg.msg_iov = conn->send_iov.data();
+        conn->send_msg.msg_iovlen = conn->send_iov.size();
+        r.ring->prepSendmsg(conn->fd, &conn->send_msg, MSG_NOSIGNAL, op_tag(*conn, kOpSend));
+        conn->send_inflight = true;
+    }
+    r.send_ready.clear();
+
+    for (const auto& conn : r.recv_rearm)
+    {
+        if (conn->recv_armed || conn->closed.load()) continue;
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        if (!conn->paused && !conn->rx_throttled) arm_recv(r, *conn);
+    }
+    r.recv_rearm.clear();
+}
+
+void Server::arm_recv(Reactor& r, Connection& conn)
+{
+    r.ring->prepRecvMultishot(conn.fd, kBufferGroup, op_tag(conn, kOpRecv));
+    conn.recv_armed = true;
+}
+
+void Server::schedule_send(Connection& conn)
+{
+    Reactor& owner = *reactors_[conn.reactor_id];
+    if (t_reactor_id == owner.id)
+        owner.send_ready.push_back(conn.shared_from_this());
+    else
+        post(owner, [&owner, c = conn.shared_from_this()]
+             { owner.send_ready.push_back(c); });
+}
+
+void Server::reap(Reactor& r, const std::shared_ptr<Connection>& conn)
+{
+    if (conn->recv_armed || conn->send_inflight) return; // its completion calls us again
+    if (conn->in_flight) return;                        // the strand posts us when it exits
+
+    auto it = r.uring_conns.find(conn.get());
+    if (it == r.uring_conns.end()) return;
+    ::close(conn->fd);
+    r.uring_conns.erase(it);
+}
+
+// ── History helper ──────────────────────────────────────────────────
+
+std::string Server::formatHistory(const std::string& nickname, int limit,
+                                  std::int64_t before_id)
+{
+    return renderHistory(db_.getVisibleMessages(nickname, userManager_.getGroupsOf(nickname),
+                                                limit, before_id),
+                         limit);
+}
+
+std::string Server::renderHistory(const std::vector<ChatMessage>& messages, int limit)
+{
+    std::ostringstream oss;
+    oss << "=== Recent Messages ===\r\n";
+
+    for (const auto& m : messages)
+    {
+        oss << "#" << m.id << " [" << format_epoch_ms(m.timestamp_ms) << "] ";
+        if (m.type == "broadcast")
+            oss << m.content << "\r\n";
+        else if (m.type == "private")
+            oss << "[Private] " << m.sender << " -> " << m.receiver << ": " << m.content << "\r\n";
+        else if (m.type == "group")
+            oss << "[Group " << m.receiver << "] " << m.sender << ": " << m.content << "\r\n";
+    }
+
+    if (messages.empty())
+        oss << "(no visible messages)\r\n";
+    else if (messages.size() == static_cast<std::size_t>(limit))
+        oss << "(older: /history before " << messages.back().id << " " << limit << ")\r\n";
+
+    return oss.str();
+}
+
+// ── Input handling ───────────────────────────────────────────────────
+
+void Server::handle_client_input(Connection& conn)
+{
+    const int fd = conn.fd;
+
+    if (conn.input_held)
+    {
+        // Resumed after auth: run what was held back before reading more
+        conn.input_held = false;
+        if (conn.closed.load() || !consume_input(conn)) return;
+    }
+
+    if (use_uring_)
+    {
+        // The reactor already received the bytes; take them in one swap
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(conn.io_mtx);
+                if (conn.closed.load() || conn.rx_pending.empty()) return;
+                conn.rx_spare.swap(conn.rx_pending);
+            }
+            std::size_t avail = 0;
+            char* space = conn.in_buf.writable(conn.rx_spare.size(), avail);
+            std::memcpy(space, conn.rx_spare.data(), conn.rx_spare.size());
+            conn.in_buf.commit(conn.rx_spare.size());
+            conn.rx_spare.clear();
+            if (!consume_input(conn)) return;
+        }
+    }
+
+    // Read until EAGAIN (drain all available data)
+    while (true)
+    {
+        std::size_t avail = 0;
+        char* space = conn.in_buf.writable(static_cast<std::size_t>(settings_.recv_buffer_size), avail);
+        ssize_t n = recv(fd, space, avail, 0);
+        if (n == 0)
+        {
+            handle_client_disconnection(fd);
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("recv");
+            handle_client_disconnection(fd);
+            return;
+        }
+
+        if (!userManager_.hasClient(fd)) return;
+        conn.in_buf.commit(static_cast<std::size_t>(n));
+        Metrics::add(Metrics::Counter::BytesIn, static_cast<std::uint64_t>(n));
+        conn.last_activity_ms.store(monotonic_ms(), std::memory_order_relaxed);
+
+        if (!consume_input(conn)) return;
+    }
+}
+
+bool Server::consume_input(Connection& conn)
+{
+    Protocol::WireMode mode = conn.mode.load(std::memory_order_relaxed);
+    if (mode == Protocol::WireMode::Pending)
+    {
+        if (!negotiate(conn)) return false;
+        mode = conn.mode.load(std::memory_order_relaxed);
+    }
+
+    if (mode == Protocol::WireMode::Text)
+        process_lines(conn);
+    else if (mode == Protocol::WireMode::Binary)
+        process_frames(conn);
+    return !conn.closed.load() && !conn.input_held; // false after /quit, a failed write, or during auth
+}
+
+bool Server::negotiate(Connection& conn)
+{
+    switch (Protocol::parseHello(conn.in_buf.peek()))
+    {
+    case Protocol::Hello::NeedMore:
+        return true;
+    case Protocol::Hello::Text:
+        conn.mode.store(Protocol::WireMode::Text);
+        return true;
+    case Protocol::Hello::Accepted:
+        break;
+    case Protocol::Hello::Rejected:
+        if (auto self = find_connection(conn.fd))
+            deliver(self, std::make_shared<const std::string>(Protocol::makeAck(1)));
+        handle_client_disconnection(conn.fd);
+        return false;
+    }
+
+    // The ack itself is raw bytes, so send it before switching modes
+    conn.in_buf.consume(Protocol::HELLO_SIZE);
+    if (auto self = find_connection(conn.fd))
+        deliver(self, std::make_shared<const std::string>(Protocol::makeAck(0)));
+    conn.mode.store(Protocol::WireMode::Binary);
+    return true;
+}
+
+void Server::process_lines(Connection& conn)
+{
+    std::string_view line;
+    while (true)
+    {
+        if (conn.auth_pending.load())
+        {
+            conn.input_held = true; // next line waits for the auth verdict
+            return;
+        }
+        if (!conn.in_buf.nextLine(line)) break;
+        if (line.empty()) continue;
+        dispatch_line(conn.fd, line);
+        if (conn.closed.load()) return;
+    }
+
+    if (conn.in_buf.takeOverflow())
+        send_to(conn.fd, "Line too long, dropped (max " +
+                             std::to_string(Config::MAX_LINE_LENGTH) + " bytes).\r\n");
+    // Any partial line stays in in_buf for the next read
+}
+
+void Server::process_frames(Connection& conn)
+{
+    while (!conn.closed.load())
+    {
+        if (conn.auth_pending.load())
+        {
+            conn.input_held = true; // next frame waits for the auth verdict
+            return;
+        }
+        std::string_view data = conn.in_buf.peek();
+        if (data.size() < Protocol::HEADER_SIZE) return;
+
+        Protocol::FrameHeader h = Protocol::decodeHeader(data.data());
+        if (h.length > Config::MAX_LINE_LENGTH)
+        {
+            // Cannot skip what we refuse to buffer: the stream is lost
+            send_frame(conn.fd, Protocol::Opcode::Error, h.request_id, "Frame too large");
+            handle_client_disconnection(conn.fd);
+            return;
+        }
+        if (data.size() < Protocol::HEADER_SIZE + h.length) return; // wait for the rest
+
+        dispatch_frame(conn.fd, h, data.substr(Protocol::HEADER_SIZE, h.length));
+        conn.in_buf.consume(Protocol::HEADER_SIZE + h.length);
+    }
+}
+
+// ── Command dispatch ─────────────────────────────────────────────────
+
+const Server::CommandSpec Server::kCommands[] = {
+    {"/quit", Protocol::Opcode::Quit, &Server::cmd_quit, false, false, Metrics::Latency::Quit},
+    {"/reg", Protocol::Opcode::Reg, &Server::cmd_reg, false, false, Metrics::Latency::Register},
+    {"/login", Protocol::Opcode::Login, &Server::cmd_login, false, false, Metrics::Latency::Login},
+    {"/history", Protocol::Opcode::History, &Server::cmd_history, true, true, Metrics::Latency::History},
+    {"/to", Protocol::Opcode::To, &Server::cmd_to, true, false, Metrics::Latency::Private},
+    {"/create", Protocol::Opcode::Create, &Server::cmd_create, true, false, Metrics::Latency::Create},
+    {"/join", Protocol::Opcode::Join, &Server::cmd_join, true, false, Metrics::Latency::Join},
+    {"/group", Protocol::Opcode::Group, &Server::cmd_group, true, false, Metrics::Latency::Group},
+    {"/stats", Protocol::Opcode::Stats, &Server::cmd_stats, true, false, Metrics::Latency::Stats},
+};
+
+const Server::CommandSpec* Server::find_command(std::string_view name)
+{
+    for (const CommandSpec& spec : kCommands)
+        if (spec.name == name) return &spec;
+    return nullptr;
+}
+
+const Server::CommandSpec* Server::find_command(Protocol::Opcode opcode)
+{
+    for (const CommandSpec& spec : kCommands)
+        if (spec.opcode == opcode) return &spec;
+    return nullptr;
+}
+
+void Server::dispatch_line(int fd, std::string_view line)
+{
+    CommandContext ctx{fd, {}, Tokenizer(line), 0, false};
+
+    // Plain chat never touches the table
+    const CommandSpec* cmd = line.front() == '/' ? find_command(ctx.args.next()) : nullptr;
+    run_command(cmd, ctx, line);
+}
+
+void Server::dispatch_frame(int fd, const Protocol::FrameHeader& h, std::string_view payload)
+{
+    CommandContext ctx{fd, {}, Tokenizer(payload), h.request_id, true};
+
+    if (h.opcode == Protocol::Opcode::Chat)
+    {
+        run_command(nullptr, ctx, payload);
+        return;
+    }
+    if (h.opcode == Protocol::Opcode::Pong) return; // receiving it already counted as activity
+    const CommandSpec* cmd = find_command(h.opcode);
+    if (!cmd)
+    {
+        send_frame(fd, Protocol::Opcode::Error, h.request_id, "Unknown opcode");
+        return;
+    }
+    run_command(cmd, ctx, {});
+}
+
+void Server::run_command(const CommandSpec* cmd, CommandContext& ctx, std::string_view text)
+{
+    bool authorized = userManager_.getAuthorizedNickname(ctx.fd, ctx.nickname);
+
+    if (cmd && (authorized || !cmd->requires_auth))
+    {
+        if (cmd->low_priority && Config::SHED_LOW_PRIORITY &&
+            overloaded_.load(std::memory_order_relaxed))
+        {
+            Metrics::add(Metrics::Counter::ShedCommands);
+            reply(ctx, "Server busy, " + std::string(cmd->name) + " is unavailable right now.\r\n");
+            return;
+        }
+        Metrics::ScopedTimer timer(cmd->latency);
+        (this->*cmd->handler)(ctx);
+        return;
+    }
+    if (!authorized)
+    {
+        reply(ctx, "Please /reg or /login first.\r\n");
+        return;
+    }
+    if (text.empty()) return;
+
+    // default (plain text or unknown command): broadcast
+    Metrics::ScopedTimer timer(Metrics::Latency::Broadcast);
+    std::string full = "[" + ctx.nickname + "]: ";
+    full.append(text).append("\r\n");
+    broadcast_message(ctx.fd, full);
+}
+
+bool Server::reply(const CommandContext& ctx, std::string_view msg,
+                   std::function<void()> on_queued)
+{
+    std::shared_ptr<Connection> conn = find_connection(ctx.fd);
+    if (!conn) return false;
+    if (ctx.binary)
+        return deliver(conn, Protocol::encodeFrame(Protocol::Opcode::Reply, ctx.request_id, msg),
+                       std::move(on_queued));
+    return deliver(conn, std::make_shared<const std::string>(msg), std::move(on_queued));
+}
+
+namespace
+{
+    /// @return Reply explaining why the credentials are unacceptable, or nullptr.
+    const char* credential_error(std::string_view user, std::string_view pass)
+    {
+        if (user.length() < Config::USERNAME_MIN_LEN ||
+            user.length() > Config::USERNAME_MAX_LEN)
+            return "Username must be 2-20 characters.\r\n";
+        if (pass.length() < Config::PASSWORD_MIN_LEN ||
+            pass.length() > Config::PASSWORD_MAX_LEN)
+            return "Password must be 6-20 characters.\r\n";
+        return nullptr;
+    }
+
+    /// @brief Parse a strictly positive decimal integer spanning all of @p s.
+    bool parse_positive(std::string_view s, long long& out)
+    {
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return ec == std::errc() && end == s.data() + s.size() && out > 0;
+    }
+}
+
+void Server::cmd_quit(CommandContext& ctx)
+{
+    reply(ctx, "Bye!\r\n");
+    handle_client_disconnection(ctx.fd);
+}
+
+void Server::cmd_reg(CommandContext& ctx)
+{
+    if (!ctx.nickname.empty())
+    {
+        reply(ctx, "Already logged in.\r\n");
+        return;
+    }
+
+    std::string_view user = ctx.args.next();
+    std::string_view pass = ctx.args.next();
+    if (user.empty() || pass.empty())
+    {
+        reply(ctx, "Usage: /reg <username> <password>\r\n");
+        return;
+    }
+    if (const char* err = credential_error(user, pass))
+    {
+        reply(ctx, err);
+        return;
+    }
+
+    std::string name(user);
+    if (userManager_.userExists(name))
+    {
+        reply(ctx, "Username already taken.\r\n"); // no need to pay for the KDF
+        return;
+    }
+    start_auth(ctx, true, std::move(name), std::string(pass));
+}
+
+void Server::cmd_login(CommandContext& ctx)
+{
+    if (!ctx.nickname.empty())
+    {
+        reply(ctx, "Already logged in.\r\n");
+        return;
+    }
+
+    std::string_view user = ctx.args.next();
+    std::string_view pass = ctx.args.next();
+    if (user.empty() || pass.empty())
+    {
+        reply(ctx, "Usage: /login <username> <password>\r\n");
+        return;
+    }
+    if (const char* err = credential_error(user, pass))
+    {
+        reply(ctx, err);
+        return;
+    }
+
+    std::string name(user);
+    std::string password(pass);
+    bool ok = false;
+    if (!userManager_.loginCached(ctx.fd, name, password, ok))
+        start_auth(ctx, false, std::move(name), std::move(password));
+    else if (ok)
+        start_auth(ctx, false, std::move(name), {}, true); // verified recently: no KDF, only the replay
+    else
+        finish_login(ctx, name, false);
+}
+
+void Server::finish_login(const CommandContext& ctx, const std::string& name, bool ok)
+{
+    if (ok)
+    {
+        reply(ctx, "Logged in as [" + name + "]\r\n");
+
+        // Only what is read here is marked delivered; later arrivals wait for the next login
+        std::vector<ChatMessage> offline = db_.offlineMessages(name);
+        std::vector<ChatMessage> history =
+            db_.getVisibleMessages(name, userManager_.getGroupsOf(name), Config::LOGIN_HISTORY);
+
+        // Delivered once the last reply is queued; the delete runs off the reactor
+        std::function<void()> delivered;
+        if (!offline.empty())
+            delivered = [this, name, offline]
+            {
+                authPool_.enqueue([this, name, offline]
+                                  {
+                                      db_.markOfflineDelivered(name, offline);
+                                      Metrics::add(Metrics::Counter::OfflineDelivered, offline.size()); });
+            };
+
+        // The history already shows the newest ones; list only the rest
+        std::unordered_set<std::int64_t> shown;
+        for (const auto& m : history)
+            shown.insert(m.id);
+        std::string batch;
+        std::size_t missed = 0;
+        for (const auto& m : offline)
+        {
+            if (shown.count(m.id)) continue;
+            batch += "[Private from " + m.sender + " at " + format_epoch_ms(m.timestamp_ms) +
+                     "]: " + m.content + "\r\n";
+            ++missed;
+        }
+
+        if (missed == 0)
+        {
+            reply(ctx, renderHistory(history, Config::LOGIN_HISTORY), std::move(delivered));
+            return;
+        }
+        reply(ctx, renderHistory(history, Config::LOGIN_HISTORY));
+        // Everything older than the history window goes out as one write
+        reply(ctx, "=== Offline Messages (" + std::to_string(missed) + ") ===\r\n" + batch,
+              std::move(delivered));
+    }
+    else
+    {
+        reply(ctx, "Login failed. Check username/password.\r\n");
+    }
+}
+
+void Server::cmd_history(CommandContext& ctx)
+{
+    // /history [before <id>] [n]
+    long long before_id = 0;
+    long long count = Config::DEFAULT_HISTORY;
+    bool ok = true;
+
+    std::string_view tok = ctx.args.next();
+    if (tok == "before")
+    {
+        ok = parse_positive(ctx.args.next(), before_id);
+        tok = ctx.args.next();
+    }
+    if (ok && !tok.empty())
+        ok = parse_positive(tok, count) && count <= Config::MAX_HISTORY_PAGE;
+    if (ok && !ctx.args.done())
+        ok = false;
+
+    if (ok)
+        reply(ctx, formatHistory(ctx.nickname, static_cast<int>(count), before_id));
+    else
+        reply(ctx, "Usage: /history [before <id>] [n]  (n = 1-" +
+                            std::to_string(Config::MAX_HISTORY_PAGE) + ")\r\n");
+}
+
+void Server::cmd_to(CommandContext& ctx)
+{
+    // /to <user> <msg>
+    std::string_view target = ctx.args.next();
+    std::string_view content = ctx.args.rest();
+    if (target.empty() || content.empty())
+    {
+        reply(ctx, "Usage: /to <username> <message>\r\n");
+        return;
+    }
+
+    std::string name(target);
+    std::string text(content);
+    int tfd = userManager_.getFdByNickname(name);
+    if (tfd == -1 || !userManager_.isLoggedIn(tfd))
+    {
+        // Store and forward: delivered by finish_login() on their next login
+        switch (db_.queueOfflineMessage(ctx.nickname, name, text))
+        {
+        case Database::OfflineResult::Queued:
+            Metrics::add(Metrics::Counter::OfflineQueued);
+            reply(ctx, "[To " + name + " (offline, queued)]: " + text + "\r\n");
+            break;
+        case Database::OfflineResult::UnknownUser:
+            reply(ctx, "User [" + name + "] does not exist.\r\n");
+            break;
+        case Database::OfflineResult::QueueFull:
+            reply(ctx, "User [" + name + "] is offline and their queue is full.\r\n");
+            break;
+        case Database::OfflineResult::Closed:
+            reply(ctx, "User [" + name + "] not online.\r\n");
+            break;
+        }
+        return;
+    }
+
+    send_to(tfd, "[Private from " + ctx.nickname + "]: " + text + "\r\n");
+    reply(ctx, "[To " + name + "]: " + text + "\r\n");
+    db_.insertMessage(ctx.nickname, name, text, "private");
+}
+
+void Server::cmd_create(CommandContext& ctx)
+{
+    // /create <group>
+    std::string gname(ctx.args.next());
+    if (gname.empty())
+        reply(ctx, "Usage: /create <groupname>\r\n");
+    else if (userManager_.createGroup(gname))
+    {
+        userManager_.joinGroup(gname, ctx.fd);
+        reply(ctx, "Group [" + gname + "] created & joined.\r\n");
+    }
+    else
+        reply(ctx, "Group [" + gname + "] already exists.\r\n");
+}
+
+void Server::cmd_join(CommandContext& ctx)
+{
+    // /join <group>
+    std::string gname(ctx.args.next());
+    if (gname.empty())
+        reply(ctx, "Usage: /join <groupname>\r\n");
+    else if (userManager_.joinGroup(gname, ctx.fd))
+        reply(ctx, "Joined [" + gname + "].\r\n");
+    else if (userManager_.isInGroup(gname, ctx.nickname))
+        reply(ctx, "Already in [" + gname + "].\r\n");
+    else
+        reply(ctx, "Group [" + gname + "] not found.\r\n");
+}
+
+void Server::cmd_group(CommandContext& ctx)
+{
+    // /group <group> <msg>
+    std::string gname(ctx.args.next());
+    std::string_view content = ctx.args.rest();
+    if (gname.empty() || content.empty())
+    {
+        reply(ctx, "Usage: /group <groupname> <message>\r\n");
+        return;
+    }
+    if (!userManager_.isInGroup(gname, ctx.nickname))
+    {
+        reply(ctx, "Not in group [" + gname + "]. Use /join first.\r\n");
+        return;
+    }
+
+    std::string text(content);
+    auto gmsg = std::make_shared<const std::string>(
+        "[Group " + gname + "] [" + ctx.nickname + "]: " + text + "\r\n");
+    auto members = userManager_.getGroupMembers(gname);
+    fan_out(collect_connections(*members), gmsg);
+    db_.insertMessage(ctx.nickname, gname, text, "group");
+}
+
+void Server::cmd_stats(CommandContext& ctx)
+{
+    if (ctx.nickname != Config::ADMIN_USER)
+    {
+        reply(ctx, "Permission denied.\r\n");
+        return;
+    }
+    reply(ctx, Metrics::renderText(gauges()));
+}
+
+// ── Auth executor ───────────────────────────────────────────────────
+
+void Server::start_auth(const CommandContext& ctx, bool registering, std::string username,
+                        std::string password, bool verified)
+{
+    std::shared_ptr<Connection> conn = find_connection(ctx.fd);
+    if (!conn) return;
+
+    // The KDF is the expensive part of the protocol: bound how much of it may queue
+    if (!verified && authPool_.depth() >= Config::AUTH_QUEUE_MAX)
+    {
+        Metrics::add(Metrics::Counter::AuthRejected);
+        reply(ctx, "Server busy, please try again later.\r\n");
+        return;
+    }
+
+    conn->auth_pending.store(true);
+    authPool_.enqueue([this, req = AuthRequest{std::move(conn), std::move(username), std::move(password),
+                                               ctx.request_id, ctx.binary, registering, verified,
+                                               Metrics::nowNs()}]() mutable
+                      { run_auth(req); });
+}
+
+void Server::run_auth(AuthRequest& req)
+{
+    Metrics::record(Metrics::Latency::AuthWait, Metrics::nowNs() - req.queued_ns);
+    Connection& conn = *req.conn;
+
+    // Nobody is waiting for the answer: skip the KDF
+    if (!conn.closed.load() && !quit.load(std::memory_order_relaxed))
+    {
+        CommandContext ctx{conn.fd, {}, Tokenizer({}), req.request_id, req.binary};
+        if (req.verified)
+            finish_login(ctx, req.username, true);
+        else if (!req.registering)
+            finish_login(ctx, req.username, userManager_.loginUser(conn.fd, req.username, req.password));
+        else if (userManager_.registerUser(conn.fd, req.username, req.password))
+            reply(ctx, "Registered as [" + req.username + "]\r\n");
+        else
+            reply(ctx, "Username already taken.\r\n");
+    }
+    resume_after_auth(req.conn);
+}
+
+void Server::resume_after_auth(const std::shared_ptr<Connection>& conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(conn->io_mtx);
+        conn->auth_pending.store(false);
+        if (!conn->auth_parked) return; // the strand is still running and will see the flag
+        conn->auth_parked = false;
+    }
+    if (quit.load(std::memory_order_relaxed)) return;
+
+    // Carry on with the strand (held input, a deferred close) where its owner runs it
+    if (inline_dispatch_)
+        post(*reactors_[conn->reactor_id], [this, conn]
+             { run_strand(conn); });
+    else
+        threadPool_.enqueue([this, conn]
+                            { run_strand(conn); });
+}
+
+// ── Metrics ─────────────────────────────────────────────────────────
+
+std::vector<Metrics::Gauge> Server::gauges() const
+{
+    std::size_t open;
+    {
+        std::shared_lock lock(conn_mtx_);
+        open = connections_.size();
+    }
+    const HistoryCache& cache = db_.historyCache();
+    return {
+        {"connections", "Open client connections", static_cast<double>(open)},
+        {"task_queue_depth", "Tasks waiting in the thread pool", static_cast<double>(threadPool_.depth())},
+        {"overloaded", "1 while reads are paused by backpressure",
+         overloaded_.load(std::memory_order_relaxed) ? 1.0 : 0.0},
+        {"db_pending_writes", "Messages queued for the write-behind thread",
+         static_cast<double>(db_.pendingWrites())},
+        {"history_cache_hits_total", "History requests served from memory",
+         static_cast<double>(cache.hits()), true},
+        {"history_cache_misses_total", "History requests that fell back to SQLite",
+         static_cast<double>(cache.misses()), true},
+        {"auth_queue_depth", "Logins and registrations waiting for the auth executor",
+         static_cast<double>(authPool_.depth())},
+        {"auth_cache_hits_total", "Logins verified from the credential cache",
+         static_cast<double>(userManager_.credentialCache().hits()), true},
+        {"auth_cache_misses_total", "Logins that ran the password KDF",
+         static_cast<double>(userManager_.credentialCache().misses()), true},
+    };
+}
+
+// ── Broadcast ───────────────────────────────────────────────────────
+
+void Server::broadcast_message(int from_fd, const std::string& msg)
+{
+    std::string nickname = userManager_.getNickname(from_fd);
+    db_.insertMessage(nickname, "ALL", msg, "broadcast");
+
+    // Snapshot under the lock, encode once, then fan out without it
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::shared_lock lock(conn_mtx_);
+        targets.reserve(connections_.size());
+        for (const auto& [fd, conn] : connections_)
+            targets.push_back(conn);
+    }
+    fan_out(std::move(targets), std::make_shared<const std::string>(msg));
 }
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "../includes/Settings.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sched.h>
+#include <thread>
+
+namespace
+{
+    constexpr std::size_t kFallbackWorkers = 4; ///< When the core count is unknown
+
+    std::size_t coreCount()
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 0 ? n : kFallbackWorkers;
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+        return s;
+    }
+
+    /// @brief Parse a decimal integer in [lo, hi] spanning all of @p s.
+    template <typename T>
+    bool parseNumber(std::string_view s, T lo, T hi, T& out)
+    {
+        T v{};
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (ec != std::errc() || end != s.data() + s.size() || v < lo || v > hi) return false;
+        out = v;
+        return true;
+    }
+
+    /// @brief Parse "0-3,8" into {0,1,2,3,8}.
+    bool parseCpuList(std::string_view s, std::vector<int>& out)
+    {
+        std::vector<int> cpus;
+        while (!s.empty())
+        {
+            std::size_t comma = s.find(',');
+            std::string_view item = trim(s.substr(0, comma));
+            s = comma == std::string_view::npos ? std::string_view() : s.substr(comma + 1);
+
+            std::size_t dash = item.find('-');
+            int first = 0, last = 0;
+            if (!parseNumber(item.substr(0, dash), 0, CPU_SETSIZE - 1, first)) return false;
+            last = first;
+            if (dash != std::string_view::npos &&
+                (!parseNumber(item.substr(dash + 1), first, CPU_SETSIZE - 1, last)))
+                return false;
+            for (int c = first; c <= last; ++c) cpus.push_back(c);
+        }
+        if (cpus.empty()) return false;
+        out = std::move(cpus);
+        return true;
+    }
+}
+
+bool Settings::set(std::string_view key, std::string_view value, std::string& err)
+{
+    constexpr int kMaxInt = std::numeric_limits<int>::max();
+    bool ok = true;
+
+    if (key == "port")
+        ok = parseNumber(value, 1, 65535, port);
+    else if (key == "backlog")
+        ok = parseNumber(value, 1, kMaxInt, listen_backlog);
+    else if (key == "workers")
+    {
+        if (value == "auto")
+            worker_threads = 0;
+        else
+            ok = parseNumber<std::size_t>(value, 1, 4096, worker_threads);
+    }
+    else if (key == "reactors")
+    {
+        if (value == "auto")
+            reactor_threads = coreCount();
+        else
+            ok = parseNumber<std::size_t>(value, 0, 4096, reactor_threads);
+    }
+    else if (key == "auth_threads")
+        ok = parseNumber<std::size_t>(value, 1, 4096, auth_threads);
+    else if (key == "io")
+    {
+        ok = value == "epoll" || value == "uring";
+        if (ok) use_io_uring = value == "uring";
+    }
+    else if (key == "epoll_events")
+        ok = parseNumber(value, 1, 65536, max_epoll_events);
+    else if (key == "recv_buffer")
+        ok = parseNumber(value, 512, 1 << 20, recv_buffer_size);
+    else if (key == "so_rcvbuf")
+        ok = parseNumber(value, 0, kMaxInt, socket_rcvbuf);
+    else if (key == "so_sndbuf")
+        ok = parseNumber(value, 0, kMaxInt, socket_sndbuf);
+    else if (key == "reactor_cpus")
+        ok = parseCpuList(value, reactor_cpus);
+    else if (key == "worker_cpus")
+        ok = parseCpuList(value, worker_cpus);
+    else if (key == "db")
+    {
+        ok = !value.empty();
+        if (ok) db_filename = std::string(value);
+    }
+    else if (key == "retention_days")
+        ok = parseNumber(value, 0, 365000, retention_days);
+    else if (key == "retention_rows")
+        ok = parseNumber<std::size_t>(value, 0, std::numeric_limits<std::size_t>::max(), retention_rows);
+    else if (key == "archive_dir")
+        archive_dir = std::string(value);
+    else if (key == "metrics_socket")
+        metrics_socket_path = std::string(value);
+    else
+    {
+        err = "unknown setting '" + std::string(key) + "'";
+        return false;
+    }
+
+    if (!ok) err = "bad value '" + std::string(value) + "' for " + std::string(key);
+    return ok;
+}
+
+bool Settings::loadFile(const std::string& path, std::string& err)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        err = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    std::string raw;
+    for (int lineno = 1; std::getline(in, raw); ++lineno)
+    {
+        std::string_view line(raw);
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        std::size_t eq = line.find('=');
+        if (eq == std::string_view::npos)
+        {
+            err = path + ":" + std::to_string(lineno) + ": expected key = value";
+            return false;
+        }
+        if (!set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)), err))
+        {
+            err = path + ":" + std::to_string(lineno) + ": " + err;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Settings::parseArgs(int argc, char** argv, bool& help, std::string& err)
+{
+    help = false;
+
+    // The file is applied first so that flags win wherever they appear
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg(argv[i]);
+        if (arg.substr(0, 9) == "--config=" && !loadFile(std::string(arg.substr(9)), err))
+            return false;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            help = true;
+            return true;
+        }
+        std::size_t eq = arg.find('=');
+        if (arg.substr(0, 2) != "--" || eq == std::string_view::npos)
+        {
+            err = "unexpected argument '" + std::string(arg) + "'";
+            return false;
+        }
+        std::string_view key = arg.substr(2, eq - 2);
+        if (key == "config") continue;
+        if (!set(key, arg.substr(eq + 1), err)) return false;
+    }
+    return true;
+}
+
+std::size_t Settings::workerThreads() const
+{
+    return worker_threads > 0 ? worker_threads : coreCount();
+}
+
+std::string Settings::usage(const char* argv0)
+{
+    return std::string("usage: ") + argv0 + " [--config=<file>] [--<key>=<value> ...]\n"
+           "  --port=<n>            TCP listen port\n"
+           "  --backlog=<n>         listen() backlog\n"
+           "  --workers=<n>|auto    Pool workers (auto = one per core)\n"
+           "  --reactors=<n>|auto   0 = one reactor + pool, N = N SO_REUSEPORT reactors\n"
+           "  --auth_threads=<n>    Password KDF workers\n"
+           "  --io=epoll|uring      I/O backend\n"
+           "  --epoll_events=<n>    Events per epoll_wait\n"
+           "  --recv_buffer=<bytes> Bytes per recv() / provided buffer\n"
+           "  --so_rcvbuf=<bytes>   Client socket receive buffer (0 = kernel default)\n"
+           "  --so_sndbuf=<bytes>   Client socket send buffer (0 = kernel default)\n"
+           "  --reactor_cpus=<list> Pin reactors round-robin to these CPUs, e.g. 0-3,8\n"
+           "  --worker_cpus=<list>  Pin pool workers likewise\n"
+           "  --db=<path>           SQLite database file\n"
+           "  --retention_days=<n>  Prune messages older than n days (0 = keep)\n"
+           "  --retention_rows=<n>  Keep at most n messages (0 = no cap)\n"
+           "  --archive_dir=<path>  Archive pruned messages as per-day .tsv.gz (empty = discard)\n"
+           "  --metrics_socket=<p>  Prometheus Unix socket (empty = off)\n"
+           "The config file takes the same keys as 'key = value' lines.\n";
+}
\ No newline at end of file
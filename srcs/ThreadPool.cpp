@@ -1,49 +1,185 @@
-#include "../includes/ThreadPool.hpp"
-
-#include <stdexcept>
-
-ThreadPool::ThreadPool(std::size_t num_threads) : stop(false)
-{
-    workers.reserve(num_threads);
-    for (std::size_t i = 0; i < num_threads; ++i)
-        workers.emplace_back(&ThreadPool::worker_thread, this);
-}
-
-void ThreadPool::worker_thread()
-{
-    while (true)
-    {
-        std::function<void()> task;
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [this]
-                    { return stop || !tasks.empty(); });
-            if (stop && tasks.empty()) return;
-            task = std::move(tasks.front());
-            tasks.pop();
-        }
-        task();
-    }
-}
-
-void ThreadPool::enqueue(std::function<void()> task)
-{
-    {
-        std::unique_lock<std::mutex> lock(mtx);
-        if (stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
-        tasks.emplace(std::move(task));
-    }
-    cv.notify_one();
-}
-
-ThreadPool::~ThreadPool()
-{
-    {
-        std::unique_lock<std::mutex> lock(mtx);
-        stop = true;
-    }
-    cv.notify_all();
-    for (auto& w : workers)
-        if (w.joinable()) w.join();
+#include "../includes/ThreadPool.hpp"
+#include "../includes/Utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+    /// Pool and queue index of the calling worker thread (nullptr elsewhere).
+    thread_local const ThreadPool* t_pool = nullptr;
+    thread_local std::size_t t_index = 0;
+}
+
+ThreadPool::ThreadPool(std::size_t num_threads, std::vector<int> pin_cpus)
+    : max_wake(std::max<std::size_t>(1, std::thread::hardware_concurrency())),
+      cpus(std::move(pin_cpus))
+{
+    queues.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i)
+        queues.push_back(std::make_unique<Queue>());
+
+    workers.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i)
+        workers.emplace_back(&ThreadPool::worker_thread, this, i);
+}
+
+ThreadPool::Queue& ThreadPool::pick_queue()
+{
+    if (t_pool == this) return *queues[t_index];
+    return *queues[next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+}
+
+void ThreadPool::enqueue(Task task)
+{
+    if (stop.load() || queues.empty())
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    // Count before pushing so a fast taker never drives queued below zero
+    queued.fetch_add(1);
+    Queue& q = pick_queue();
+    {
+        std::lock_guard<std::mutex> lock(q.mtx);
+        q.tasks.push_back(std::move(task));
+    }
+    wake(1);
+}
+
+void ThreadPool::enqueue_batch(std::vector<Task>& tasks)
+{
+    if (tasks.empty()) return;
+    if (stop.load() || queues.empty())
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    std::size_t n = tasks.size();
+    queued.fetch_add(n);
+    for (Task& task : tasks)
+    {
+        Queue& q = pick_queue();
+        std::lock_guard<std::mutex> lock(q.mtx);
+        q.tasks.push_back(std::move(task));
+    }
+    tasks.clear();
+    wake(n);
+}
+
+void ThreadPool::wake(std::size_t n)
+{
+    // queued was bumped first and a worker drops searching / bumps idle
+    // before re-checking queued, so one of the two sides sees the other.
+    // A worker that is already searching will find the new work itself.
+    if (searching.load() > 0) return;
+    std::size_t sleepers = idle.load();
+    if (sleepers == 0) return;
+
+    // Waking more workers than there are cores only adds context
+    // switches; a woken worker passes the wakeup on if work remains.
+    n = std::min({n, sleepers, max_wake});
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+    while (n-- > 0) cv.notify_one();
+}
+
+bool ThreadPool::pop_own(std::size_t self, Task& out)
+{
+    Queue& own = *queues[self];
+    std::lock_guard<std::mutex> lock(own.mtx);
+    if (own.tasks.empty()) return false;
+    out = std::move(own.tasks.front());
+    own.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(std::size_t self, Task& out)
+{
+    // First pass skips busy peers; the second waits for them, so a
+    // worker never spins while tasks it could take sit behind a lock.
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (std::size_t k = 1; k < queues.size(); ++k)
+        {
+            Queue& victim = *queues[(self + k) % queues.size()];
+            std::unique_lock<std::mutex> lock(victim.mtx, std::defer_lock);
+            if (pass == 0)
+            {
+                if (!lock.try_lock()) continue;
+            }
+            else
+            {
+                lock.lock();
+            }
+            if (victim.tasks.empty()) continue;
+
+            // Take the newer half so the next few pops stay local
+            std::size_t n = (victim.tasks.size() + 1) / 2;
+            std::vector<Task> loot;
+            loot.reserve(n - 1);
+            out = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            while (loot.size() < n - 1)
+            {
+                loot.push_back(std::move(victim.tasks.back()));
+                victim.tasks.pop_back();
+            }
+            lock.unlock();
+
+            if (!loot.empty())
+            {
+                Queue& own = *queues[self];
+                std::lock_guard<std::mutex> own_lock(own.mtx);
+                for (auto it = loot.rbegin(); it != loot.rend(); ++it)
+                    own.tasks.push_back(std::move(*it));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_thread(std::size_t index)
+{
+    t_pool = this;
+    t_index = index;
+    if (!cpus.empty() && !pin_current_thread(cpus[index % cpus.size()]))
+        perror("pin worker thread");
+
+    while (true)
+    {
+        Task task;
+        if (pop_own(index, task))
+        {
+            queued.fetch_sub(1);
+            task();
+            continue;
+        }
+
+        searching.fetch_add(1);
+        bool found = steal(index, task);
+        bool last = searching.fetch_sub(1) == 1;
+        if (found)
+        {
+            // The last searcher hands the search on if work remains
+            if (queued.fetch_sub(1) > 1 && last) wake(1);
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mtx);
+        idle.fetch_add(1);
+        cv.wait(lock, [this]
+                { return stop.load() || queued.load() > 0; });
+        idle.fetch_sub(1);
+        if (stop.load() && queued.load() == 0) return;
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+        stop.store(true);
+    }
+    cv.notify_all();
+    for (auto& w : workers)
+        if (w.joinable()) w.join();
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "../includes/TimerWheel.hpp"
+#include "../includes/Connection.hpp"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::size_t slots, std::int64_t tick_ms)
+    : slots_(slots), tick_ms_(tick_ms) {}
+
+void TimerWheel::schedule(const std::shared_ptr<Connection>& conn, std::int64_t deadline_ms)
+{
+    conn->timer_deadline_ms = deadline_ms;
+
+    // A deadline already behind the wheel goes into the next bucket due
+    std::int64_t tick = std::max(deadline_ms / tick_ms_, current_tick_ + 1);
+    slots_[static_cast<std::size_t>(tick) % slots_.size()].push_back({conn, deadline_ms});
+    ++size_;
+}
+
+void TimerWheel::advance(std::int64_t now_ms, std::vector<std::shared_ptr<Connection>>& due)
+{
+    // A bucket is swept once its whole tick has elapsed, so every entry
+    // in it is due and deadlines fire at most one tick late.
+    const auto n = static_cast<std::int64_t>(slots_.size());
+    std::int64_t done_tick = now_ms / tick_ms_ - 1;
+    if (current_tick_ < 0 || done_tick - current_tick_ > n)
+        current_tick_ = done_tick - n; // first call or a long stall: one full sweep
+
+    for (std::int64_t t = current_tick_ + 1; t <= done_tick; ++t)
+    {
+        std::vector<Entry>& bucket = slots_[static_cast<std::size_t>(t % n)];
+        for (std::size_t i = 0; i < bucket.size();)
+        {
+            Entry& e = bucket[i];
+            if (e.deadline_ms > now_ms)
+            {
+                ++i; // due on a later revolution
+                continue;
+            }
+
+            std::shared_ptr<Connection> conn = e.conn.lock();
+            if (conn && conn->timer_deadline_ms == e.deadline_ms)
+                due.push_back(std::move(conn));
+
+            e = std::move(bucket.back());
+            bucket.pop_back();
+            --size_;
+        }
+    }
+    current_tick_ = std::max(current_tick_, done_tick);
+}
+
+int TimerWheel::waitMs(std::int64_t now_ms, int cap_ms) const
+{
+    if (size_ == 0 || current_tick_ < 0) return cap_ms;
+
+    // Only the buckets inside the cap matter; later ones can wait
+    std::int64_t last = (now_ms + cap_ms) / tick_ms_;
+    for (std::int64_t t = current_tick_ + 1; t <= last; ++t)
+    {
+        if (slots_[static_cast<std::size_t>(t % static_cast<std::int64_t>(slots_.size()))].empty())
+            continue;
+        std::int64_t wait = (t + 1) * tick_ms_ - now_ms; // bucket t is swept when tick t ends
+        return static_cast<int>(std::clamp<std::int64_t>(wait, 0, cap_ms));
+    }
+    return cap_ms;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "../includes/Tokenizer.hpp"
+
+namespace
+{
+    bool isSpace(char c) { return c == ' ' || c == '\t'; }
+}
+
+Tokenizer::Tokenizer(std::string_view text)
+    : text_(text) {}
+
+void Tokenizer::skipSpace()
+{
+    while (pos_ < text_.size() && isSpace(text_[pos_])) ++pos_;
+}
+
+std::string_view Tokenizer::next()
+{
+    skipSpace();
+    std::size_t start = pos_;
+    while (pos_ < text_.size() && !isSpace(text_[pos_])) ++pos_;
+    return text_.substr(start, pos_ - start);
+}
+
+std::string_view Tokenizer::rest()
+{
+    skipSpace();
+    std::string_view r = text_.substr(pos_);
+    pos_ = text_.size();
+    return r;
+}
+
+bool Tokenizer::done()
+{
+    skipSpace();
+    return pos_ == text_.size();
+}
\ No newline at end of file
@@ -1,150 +1,438 @@
-#include "../includes/UserManager.hpp"
-#include "../includes/Utils.hpp"
-
-UserManager::UserManager(Database& db) : db_(db) {}
-
-// ── Auth ────────────────────────────────────────────────────────────
-
-bool UserManager::registerUser(int fd, const std::string& username,
-                               const std::string& password)
-{
-    std::string pw_hash = hash_password(password);
-
-    // Persist to DB first (DB has its own mutex)
-    if (!db_.insertUser(username, pw_hash))
-        return false; // username already taken
-
-    std::unique_lock lock(mtx_);
-    ClientSession& s = clients_[fd];
-    s.nickname = username;
-    s.status = AuthStatus::AUTHORIZED;
-    nickname_map_[username] = fd;
-    return true;
-}
-
-bool UserManager::loginUser(int fd, const std::string& username,
-                            const std::string& password)
-{
-    // Verify credentials against DB
-    std::string stored_hash;
-    if (!db_.getUserPasswordHash(username, stored_hash))
-        return false; // user doesn't exist
-
-    if (stored_hash != hash_password(password))
-        return false; // wrong password
-
-    std::unique_lock lock(mtx_);
-    if (nickname_map_.count(username))
-        return false; // already logged in elsewhere
-
-    ClientSession& s = clients_[fd];
-    s.nickname = username;
-    s.status = AuthStatus::AUTHORIZED;
-    nickname_map_[username] = fd;
-    return true;
-}
-
-bool UserManager::isLoggedIn(int fd) const
-{
-    std::shared_lock lock(mtx_);
-    auto it = clients_.find(fd);
-    return it != clients_.end() && it->second.status == AuthStatus::AUTHORIZED;
-}
-
-std::string UserManager::getNickname(int fd) const
-{
-    std::shared_lock lock(mtx_);
-    auto it = clients_.find(fd);
-    return (it != clients_.end()) ? it->second.nickname : "";
-}
-
-void UserManager::logoutUser(int fd)
-{
-    std::unique_lock lock(mtx_);
-    auto it = clients_.find(fd);
-    if (it == clients_.end()) return;
-
-    nickname_map_.erase(it->second.nickname);
-    it->second.status = AuthStatus::NONE;
-    it->second.nickname.clear();
-}
-
-// ── Session tracking ────────────────────────────────────────────────
-
-void UserManager::addClient(int fd)
-{
-    std::unique_lock lock(mtx_);
-    clients_[fd] = ClientSession(fd);
-}
-
-void UserManager::removeClient(int fd)
-{
-    std::unique_lock lock(mtx_);
-    auto it = clients_.find(fd);
-    if (it == clients_.end()) return;
-
-    // Remove nickname mapping BEFORE erasing the session
-    nickname_map_.erase(it->second.nickname);
-    clients_.erase(it);
-}
-
-bool UserManager::hasClient(int fd) const
-{
-    std::shared_lock lock(mtx_);
-    return clients_.count(fd) > 0;
-}
-
-std::vector<int> UserManager::getAllFds() const
-{
-    std::shared_lock lock(mtx_);
-    std::vector<int> fds;
-    fds.reserve(clients_.size());
-    for (const auto& [fd, _] : clients_)
-        fds.push_back(fd);
-    return fds;
-}
-
-ClientSession UserManager::getSession(int fd) const
-{
-    std::shared_lock lock(mtx_);
-    return clients_.at(fd); // returns a copy — safe across threads
-}
-
-int UserManager::getFdByNickname(const std::string& nickname) const
-{
-    std::shared_lock lock(mtx_);
-    auto it = nickname_map_.find(nickname);
-    return (it != nickname_map_.end()) ? it->second : -1;
-}
-
-// ── Groups ──────────────────────────────────────────────────────────
-
-bool UserManager::createGroup(const std::string& groupname)
-{
-    std::unique_lock lock(mtx_);
-    if (groups_.count(groupname)) return false;
-    groups_[groupname] = {};
-    return true;
-}
-
-bool UserManager::joinGroup(const std::string& groupname, int fd)
-{
-    std::unique_lock lock(mtx_);
-    auto it = groups_.find(groupname);
-    if (it == groups_.end()) return false;
-    return it->second.insert(fd).second; // false if already a member
-}
-
-bool UserManager::isInGroup(const std::string& groupname, int fd) const
-{
-    std::shared_lock lock(mtx_);
-    auto it = groups_.find(groupname);
-    return it != groups_.end() && it->second.count(fd);
-}
-
-std::unordered_set<int> UserManager::getGroupMembers(const std::string& groupname) const
-{
-    std::shared_lock lock(mtx_);
-    auto it = groups_.find(groupname);
-    return (it != groups_.end()) ? it->second : std::unordered_set<int>{};
+#include "../includes/UserManager.hpp"
+#include "../includes/Metrics.hpp"
+#include "../includes/Utils.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <sys/resource.h>
+
+namespace
+{
+    constexpr std::size_t kMaxTableFds = std::size_t{1} << 22;
+
+    /// @brief Default table size: the process fd limit, clamped.
+    std::size_t defaultMaxFds()
+    {
+        rlimit rl{};
+        if (getrlimit(RLIMIT_NOFILE, &rl) == -1 || rl.rlim_cur == RLIM_INFINITY)
+            return kMaxTableFds;
+        return std::min<std::size_t>(rl.rlim_cur, kMaxTableFds);
+    }
+}
+
+UserManager::UserManager(Database& db, std::size_t max_fds, std::uint32_t kdf_iterations)
+    : db_(db),
+      kdf_iterations_(kdf_iterations),
+      credentials_(Config::AUTH_CACHE_SIZE, Config::AUTH_CACHE_TTL_MS),
+      max_fds_(max_fds > 0 ? max_fds : defaultMaxFds())
+{
+    std::size_t nchunks = (max_fds_ + kChunkSize - 1) / kChunkSize;
+    chunks_ = std::make_unique<std::atomic<Slot*>[]>(nchunks);
+    for (std::size_t i = 0; i < nchunks; ++i)
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+UserManager::~UserManager()
+{
+    std::size_t nchunks = (max_fds_ + kChunkSize - 1) / kChunkSize;
+    for (std::size_t i = 0; i < nchunks; ++i)
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+}
+
+// ── Table helpers ───────────────────────────────────────────────────
+
+UserManager::Slot* UserManager::findSlot(int fd) const
+{
+    if (fd < 0 || static_cast<std::size_t>(fd) >= max_fds_) return nullptr;
+    Slot* chunk = chunks_[static_cast<std::size_t>(fd) / kChunkSize].load(std::memory_order_acquire);
+    return chunk ? &chunk[static_cast<std::size_t>(fd) % kChunkSize] : nullptr;
+}
+
+UserManager::Slot* UserManager::ensureSlot(int fd)
+{
+    if (fd < 0 || static_cast<std::size_t>(fd) >= max_fds_) return nullptr;
+
+    std::atomic<Slot*>& entry = chunks_[static_cast<std::size_t>(fd) / kChunkSize];
+    Slot* chunk = entry.load(std::memory_order_acquire);
+    if (!chunk)
+    {
+        // Racing allocators: the loser frees its chunk and uses the winner's
+        Slot* fresh = new Slot[kChunkSize];
+        if (entry.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel))
+            chunk = fresh;
+        else
+            delete[] fresh;
+    }
+    return &chunk[static_cast<std::size_t>(fd) % kChunkSize];
+}
+
+UserManager::NickStripe& UserManager::nickStripe(const std::string& nickname)
+{
+    return nick_stripes_[std::hash<std::string>{}(nickname) & (kStripes - 1)];
+}
+
+const UserManager::NickStripe& UserManager::nickStripe(const std::string& nickname) const
+{
+    return nick_stripes_[std::hash<std::string>{}(nickname) & (kStripes - 1)];
+}
+
+bool UserManager::bindNickname(int fd, const std::string& username)
+{
+    // Lock order is always nickname stripe → session stripe → groups_mtx_
+    NickStripe& ns = nickStripe(username);
+    std::unique_lock nlock(ns.mtx);
+    if (ns.fds.count(username))
+        return false; // already logged in elsewhere
+
+    Slot* slot = findSlot(fd);
+    if (!slot) return false;
+
+    std::unique_lock slock(sessionLock(fd));
+    if (!(slot->flags.load(std::memory_order_relaxed) & kActive))
+        return false; // disconnected meanwhile
+
+    slot->session.nickname = username;
+    slot->session.status = AuthStatus::AUTHORIZED;
+    slot->flags.store(kActive | kAuthorized, std::memory_order_release);
+    ns.fds.emplace(username, fd);
+    slock.unlock();
+
+    setMemberFd(username, fd);
+    return true;
+}
+
+// ── Auth ────────────────────────────────────────────────────────────
+
+bool UserManager::registerUser(int fd, const std::string& username,
+                               const std::string& password)
+{
+    std::string pw_hash;
+    {
+        Metrics::ScopedTimer timer(Metrics::Latency::AuthKdf);
+        pw_hash = hash_password(password, kdf_iterations_);
+    }
+    if (pw_hash.empty())
+        return false; // no randomness for a salt
+
+    // Persist to DB first (DB has its own mutex)
+    if (!db_.insertUser(username, pw_hash))
+        return false; // username already taken
+
+    credentials_.remember(username, password);
+    return bindNickname(fd, username);
+}
+
+bool UserManager::loginUser(int fd, const std::string& username,
+                            const std::string& password)
+{
+    // Verify credentials against DB
+    std::string stored_hash;
+    if (!db_.getUserPasswordHash(username, stored_hash))
+        return false; // user doesn't exist
+
+    bool needs_rehash = false;
+    {
+        Metrics::ScopedTimer timer(Metrics::Latency::AuthKdf);
+        if (!verify_password(password, stored_hash, kdf_iterations_, needs_rehash))
+            return false; // wrong password
+    }
+
+    if (needs_rehash)
+    {
+        // Legacy or cheaper hash: upgrade it while we hold the plaintext
+        Metrics::ScopedTimer timer(Metrics::Latency::AuthKdf);
+        std::string upgraded = hash_password(password, kdf_iterations_);
+        if (!upgraded.empty())
+            db_.updateUserPasswordHash(username, upgraded);
+    }
+
+    credentials_.remember(username, password);
+    return bindNickname(fd, username);
+}
+
+bool UserManager::loginCached(int fd, const std::string& username,
+                              const std::string& password, bool& ok)
+{
+    if (!credentials_.check(username, password))
+        return false;
+
+    ok = bindNickname(fd, username);
+    return true;
+}
+
+bool UserManager::isLoggedIn(int fd) const
+{
+    const Slot* slot = findSlot(fd);
+    return slot && (slot->flags.load(std::memory_order_acquire) & kAuthorized);
+}
+
+std::string UserManager::getNickname(int fd) const
+{
+    const Slot* slot = findSlot(fd);
+    if (!slot) return "";
+
+    std::shared_lock lock(sessionLock(fd));
+    return (slot->flags.load(std::memory_order_relaxed) & kActive) ? slot->session.nickname : "";
+}
+
+bool UserManager::getAuthorizedNickname(int fd, std::string& nickname) const
+{
+    const Slot* slot = findSlot(fd);
+    if (!slot) return false;
+
+    std::shared_lock lock(sessionLock(fd));
+    if (!(slot->flags.load(std::memory_order_relaxed) & kAuthorized))
+        return false;
+    nickname = slot->session.nickname;
+    return true;
+}
+
+void UserManager::logoutUser(int fd)
+{
+    Slot* slot = findSlot(fd);
+    if (!slot) return;
+
+    std::string nickname;
+    {
+        std::unique_lock lock(sessionLock(fd));
+        if (!(slot->flags.load(std::memory_order_relaxed) & kActive)) return;
+        nickname.swap(slot->session.nickname);
+        slot->session.status = AuthStatus::NONE;
+        slot->flags.store(kActive, std::memory_order_release);
+    }
+    if (nickname.empty()) return;
+
+    NickStripe& ns = nickStripe(nickname);
+    std::unique_lock lock(ns.mtx);
+    auto it = ns.fds.find(nickname);
+    if (it != ns.fds.end() && it->second == fd)
+    {
+        ns.fds.erase(it);
+        setMemberFd(nickname, -1);
+    }
+}
+
+// ── Session tracking ────────────────────────────────────────────────
+
+bool UserManager::addClient(int fd)
+{
+    Slot* slot = ensureSlot(fd);
+    if (!slot) return false;
+
+    std::unique_lock lock(sessionLock(fd));
+    slot->session = ClientSession(fd);
+    slot->flags.store(kActive, std::memory_order_release);
+    return true;
+}
+
+void UserManager::removeClient(int fd)
+{
+    Slot* slot = findSlot(fd);
+    if (!slot) return;
+
+    // Deactivate first so a racing bindNickname() cannot re-add the name
+    std::string nickname;
+    {
+        std::unique_lock lock(sessionLock(fd));
+        if (!(slot->flags.load(std::memory_order_relaxed) & kActive)) return;
+        nickname.swap(slot->session.nickname);
+        slot->flags.store(0, std::memory_order_release);
+        slot->session = ClientSession();
+    }
+    if (nickname.empty()) return;
+
+    NickStripe& ns = nickStripe(nickname);
+    std::unique_lock lock(ns.mtx);
+    auto it = ns.fds.find(nickname);
+    if (it != ns.fds.end() && it->second == fd)
+    {
+        ns.fds.erase(it);
+        setMemberFd(nickname, -1);
+    }
+}
+
+bool UserManager::hasClient(int fd) const
+{
+    const Slot* slot = findSlot(fd);
+    return slot && (slot->flags.load(std::memory_order_acquire) & kActive);
+}
+
+std::vector<int> UserManager::getAllFds() const
+{
+    std::vector<int> fds;
+    std::size_t nchunks = (max_fds_ + kChunkSize - 1) / kChunkSize;
+    for (std::size_t c = 0; c < nchunks; ++c)
+    {
+        const Slot* chunk = chunks_[c].load(std::memory_order_acquire);
+        if (!chunk) continue;
+        for (std::size_t i = 0; i < kChunkSize; ++i)
+            if (chunk[i].flags.load(std::memory_order_acquire) & kActive)
+                fds.push_back(static_cast<int>(c * kChunkSize + i));
+    }
+    return fds;
+}
+
+ClientSession UserManager::getSession(int fd) const
+{
+    const Slot* slot = findSlot(fd);
+    std::shared_lock lock(sessionLock(fd));
+    if (!slot || !(slot->flags.load(std::memory_order_relaxed) & kActive))
+        throw std::out_of_range("UserManager::getSession: unknown fd");
+    return slot->session; // returns a copy — safe across threads
+}
+
+int UserManager::getFdByNickname(const std::string& nickname) const
+{
+    const NickStripe& ns = nickStripe(nickname);
+    std::shared_lock lock(ns.mtx);
+    auto it = ns.fds.find(nickname);
+    return (it != ns.fds.end()) ? it->second : -1;
+}
+
+// ── Groups ──────────────────────────────────────────────────────────
+
+std::uint32_t UserManager::memberId(const std::string& username)
+{
+    auto [it, fresh] = member_ids_.try_emplace(username, static_cast<std::uint32_t>(members_.size()));
+    if (fresh) members_.push_back(Member{username, -1, {}});
+    return it->second;
+}
+
+void UserManager::setMemberFd(const std::string& username, int fd)
+{
+    std::unique_lock lock(groups_mtx_);
+    auto it = member_ids_.find(username);
+    if (it == member_ids_.end()) return; // in no group
+
+    Member& m = members_[it->second];
+    int old = m.fd;
+    if (old == fd) return;
+    m.fd = fd;
+
+    // Each snapshot only ever holds online members, so this is O(online)
+    for (std::uint32_t gid : m.groups)
+    {
+        Group& g = groups_[gid];
+        auto next = std::make_shared<std::vector<int>>();
+        next->reserve(g.online->size() + 1);
+        for (int member_fd : *g.online)
+            if (member_fd != old) next->push_back(member_fd);
+        if (fd >= 0) next->push_back(fd);
+        g.online = std::move(next);
+    }
+}
+
+std::size_t UserManager::loadGroups()
+{
+    std::vector<Database::GroupRecord> records = db_.loadGroups();
+
+    std::unique_lock lock(groups_mtx_);
+    group_ids_.clear();
+    groups_.clear();
+    member_ids_.clear();
+    members_.clear();
+
+    for (auto& rec : records)
+    {
+        auto gid = static_cast<std::uint32_t>(groups_.size());
+        group_ids_.emplace(rec.name, gid);
+        groups_.push_back(Group{rec.id, std::move(rec.name), {}, std::make_shared<const std::vector<int>>()});
+        for (const auto& username : rec.members)
+        {
+            std::uint32_t uid = memberId(username);
+            groups_[gid].members.push_back(uid);
+            members_[uid].groups.push_back(gid);
+        }
+    }
+    return groups_.size();
+}
+
+bool UserManager::createGroup(const std::string& groupname)
+{
+    {
+        std::shared_lock lock(groups_mtx_);
+        if (group_ids_.count(groupname)) return false; // skip the DB write
+    }
+
+    // The UNIQUE constraint settles racing creators
+    std::int64_t db_id = db_.insertGroup(groupname);
+    if (db_id == 0) return false;
+
+    std::unique_lock lock(groups_mtx_);
+    group_ids_.emplace(groupname, static_cast<std::uint32_t>(groups_.size()));
+    groups_.push_back(Group{db_id, groupname, {}, std::make_shared<const std::vector<int>>()});
+    return true;
+}
+
+bool UserManager::joinGroup(const std::string& groupname, int fd)
+{
+    std::string username;
+    if (!getAuthorizedNickname(fd, username)) return false;
+
+    std::int64_t db_id = 0;
+    {
+        std::shared_lock lock(groups_mtx_);
+        auto it = group_ids_.find(groupname);
+        if (it == group_ids_.end()) return false;
+        db_id = groups_[it->second].db_id;
+    }
+    if (!db_.insertGroupMember(db_id, username)) return false; // already a member
+
+    // Hold the nickname stripe so a concurrent login / logout can't
+    // slip between reading the online fd and publishing the snapshot
+    const NickStripe& ns = nickStripe(username);
+    std::shared_lock nlock(ns.mtx);
+    std::unique_lock lock(groups_mtx_);
+
+    std::uint32_t gid = group_ids_.at(groupname); // groups are never removed
+    std::uint32_t uid = memberId(username);
+    Group& g = groups_[gid];
+    Member& m = members_[uid];
+    g.members.push_back(uid);
+    m.groups.push_back(gid);
+
+    auto online = ns.fds.find(username);
+    m.fd = (online != ns.fds.end()) ? online->second : -1;
+    if (m.fd >= 0)
+    {
+        auto next = std::make_shared<std::vector<int>>(*g.online);
+        next->push_back(m.fd);
+        g.online = std::move(next);
+    }
+    return true;
+}
+
+bool UserManager::isInGroup(const std::string& groupname, const std::string& username) const
+{
+    std::shared_lock lock(groups_mtx_);
+    auto git = group_ids_.find(groupname);
+    auto uit = member_ids_.find(username);
+    if (git == group_ids_.end() || uit == member_ids_.end()) return false;
+
+    const auto& joined = members_[uit->second].groups;
+    return std::find(joined.begin(), joined.end(), git->second) != joined.end();
+}
+
+std::vector<std::string> UserManager::getGroupsOf(const std::string& username) const
+{
+    std::shared_lock lock(groups_mtx_);
+    std::vector<std::string> names;
+    auto it = member_ids_.find(username);
+    if (it == member_ids_.end()) return names;
+
+    names.reserve(members_[it->second].groups.size());
+    for (std::uint32_t gid : members_[it->second].groups)
+        names.push_back(groups_[gid].name);
+    return names;
+}
+
+std::shared_ptr<const std::vector<int>> UserManager::getGroupMembers(const std::string& groupname) const
+{
+    static const auto kEmpty = std::make_shared<const std::vector<int>>();
+
+    std::shared_lock lock(groups_mtx_);
+    auto it = group_ids_.find(groupname);
+    return (it != group_ids_.end()) ? groups_[it->second].online : kEmpty;
 }
\ No newline at end of file
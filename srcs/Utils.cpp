@@ -1,52 +1,204 @@
-#include "../includes/Utils.hpp"
-#include <cerrno>
-#include <cstdio>
-#include <fcntl.h>
-#include <functional>
-#include <iomanip>
-#include <sstream>
-#include <sys/socket.h>
-#include <unistd.h>
-
-void set_nonblocking(int fd)
-{
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1)
-    {
-        perror("fcntl F_GETFL");
-        return;
-    }
-    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
-        perror("fcntl F_SETFL");
-}
-
-bool safe_send(int fd, const char* data, std::size_t len)
-{
-    std::size_t sent = 0;
-    while (sent < len)
-    {
-        ssize_t n = ::send(fd, data + sent, len - sent, MSG_NOSIGNAL);
-        if (n < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
-            perror("send");
-            return false;
-        }
-        sent += static_cast<std::size_t>(n);
-    }
-    return true;
-}
-
-bool safe_send(int fd, const std::string& msg)
-{
-    return safe_send(fd, msg.c_str(), msg.size());
-}
-
-std::string hash_password(const std::string& password)
-{
-    // NOTE: std::hash is NOT cryptographic. Use bcrypt/argon2 in production.
-    std::size_t h = std::hash<std::string>{}(password);
-    std::ostringstream oss;
-    oss << std::hex << std::setfill('0') << std::setw(16) << h;
-    return oss.str();
+#include "../includes/Utils.hpp"
+#include "../includes/Crypto.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1)
+    {
+        perror("fcntl F_GETFL");
+        return;
+    }
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+        perror("fcntl F_SETFL");
+}
+
+ssize_t send_nonblocking(int fd, const char* data, std::size_t len)
+{
+    std::size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t n = ::send(fd, data + sent, len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return static_cast<ssize_t>(sent);
+}
+
+ssize_t sendv_nonblocking(int fd, const iovec* iov, int iovcnt)
+{
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec*>(iov);
+    msg.msg_iovlen = static_cast<std::size_t>(iovcnt);
+
+    while (true)
+    {
+        ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n >= 0) return n;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+bool safe_send(int fd, const char* data, std::size_t len)
+{
+    std::size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t n = send_nonblocking(fd, data + sent, len - sent);
+        if (n < 0)
+        {
+            perror("send");
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+        if (sent == len) break;
+
+        // Socket is full: sleep until it drains instead of spinning
+        pollfd pfd{fd, POLLOUT, 0};
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+        {
+            perror("poll");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool safe_send(int fd, const std::string& msg)
+{
+    return safe_send(fd, msg.c_str(), msg.size());
+}
+
+std::int64_t monotonic_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+std::int64_t epoch_ms_coarse()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+std::string format_epoch_ms(std::int64_t epoch_ms)
+{
+    // Zone offsets are whole minutes, so a minute's prefix never changes
+    thread_local std::int64_t t_minute = std::numeric_limits<std::int64_t>::min();
+    thread_local char t_prefix[sizeof("YYYY-MM-DD HH:MM:")] = {};
+
+    std::int64_t secs = epoch_ms >= 0 ? epoch_ms / 1000 : (epoch_ms - 999) / 1000;
+    std::int64_t minute = secs >= 0 ? secs / 60 : (secs - 59) / 60;
+    if (minute != t_minute)
+    {
+        std::time_t start = static_cast<std::time_t>(minute * 60);
+        std::tm local{};
+        if (!localtime_r(&start, &local) ||
+            std::strftime(t_prefix, sizeof(t_prefix), "%F %H:%M:", &local) == 0)
+            return std::to_string(epoch_ms);
+        t_minute = minute;
+    }
+
+    int sec = static_cast<int>(secs - minute * 60);
+    std::string out(t_prefix);
+    out.push_back(static_cast<char>('0' + sec / 10));
+    out.push_back(static_cast<char>('0' + sec % 10));
+    return out;
+}
+
+bool pin_current_thread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    errno = rc;
+    return rc == 0;
+}
+
+namespace
+{
+    constexpr const char* kKdfPrefix = "pbkdf2-sha256$";
+    constexpr std::size_t kSaltBytes = 16;
+    constexpr std::size_t kKeyBytes = Crypto::DIGEST_SIZE;
+
+    /// The pre-KDF scheme, only ever used to verify old rows.
+    std::string legacy_hash(const std::string& password)
+    {
+        std::size_t h = std::hash<std::string>{}(password);
+        std::ostringstream oss;
+        oss << std::hex << std::setfill('0') << std::setw(16) << h;
+        return oss.str();
+    }
+}
+
+std::string hash_password(const std::string& password, std::uint32_t iterations)
+{
+    std::uint8_t salt[kSaltBytes];
+    if (!Crypto::randomBytes(salt, sizeof(salt))) return "";
+
+    std::uint8_t key[kKeyBytes];
+    Crypto::pbkdf2Sha256(password, std::string_view(reinterpret_cast<const char*>(salt), sizeof(salt)),
+                         iterations, key, sizeof(key));
+
+    return kKdfPrefix + std::to_string(iterations) + "$" + Crypto::toHex(salt, sizeof(salt)) +
+           "$" + Crypto::toHex(key, sizeof(key));
+}
+
+bool verify_password(const std::string& password, const std::string& stored,
+                     std::uint32_t iterations, bool& needs_rehash)
+{
+    needs_rehash = false;
+    std::string_view rest(stored);
+    const std::string_view prefix(kKdfPrefix);
+    if (rest.substr(0, prefix.size()) != prefix)
+    {
+        needs_rehash = true;
+        return stored == legacy_hash(password);
+    }
+    rest.remove_prefix(prefix.size());
+
+    // <iterations>$<salt hex>$<key hex>
+    std::size_t d1 = rest.find('$');
+    std::size_t d2 = rest.find('$', d1 == std::string_view::npos ? d1 : d1 + 1);
+    if (d2 == std::string_view::npos) return false;
+
+    std::uint32_t cost = 0;
+    auto [end, ec] = std::from_chars(rest.data(), rest.data() + d1, cost);
+    std::string salt, expected;
+    if (ec != std::errc() || end != rest.data() + d1 || cost == 0 ||
+        !Crypto::fromHex(rest.substr(d1 + 1, d2 - d1 - 1), salt) ||
+        !Crypto::fromHex(rest.substr(d2 + 1), expected) || expected.size() != kKeyBytes)
+        return false;
+
+    std::uint8_t key[kKeyBytes];
+    Crypto::pbkdf2Sha256(password, salt, cost, key, sizeof(key));
+    needs_rehash = cost < iterations;
+    return Crypto::constantTimeEqual(key, reinterpret_cast<const std::uint8_t*>(expected.data()),
+                                     sizeof(key));
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "../includes/Server.hpp"
 #include <csignal>
 #include <iostream>
+#include <string>
 
 /// @brief Signal handler for graceful shutdown.
 static void signal_handler(int sig)
@@ -9,13 +10,29 @@ static void signal_handler(int sig)
     Server::quit.store(true, std::memory_order_relaxed);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    // Config.hpp defaults, then --config=<file>, then the other flags
+    Settings settings;
+    bool help = false;
+    std::string err;
+    if (!settings.parseArgs(argc, argv, help, err))
+    {
+        std::cerr << argv[0] << ": " << err << "\n"
+                  << Settings::usage(argv[0]);
+        return 1;
+    }
+    if (help)
+    {
+        std::cout << Settings::usage(argv[0]);
+        return 0;
+    }
+
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
     std::signal(SIGPIPE, SIG_IGN); // ignore broken pipe from disconnected clients
 
-    Server server;
+    Server server(settings);
     server.run_server();
 
     return 0;